@@ -1,18 +1,31 @@
 // Hi, this is my AdventOfCode 2020 stuff
 
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <limits.h>
 #include <map>
+#include <memory>
+#include <math.h>
+#include <mutex>
 #include <set>
 #include <sstream>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 
 ////////////////////////////
 ////////////////////////////
@@ -38,6 +51,231 @@ const BigInt MAX_BIG_UINT = ULLONG_MAX;
 typedef std::vector<bool> BoolList;
 
 
+////////////////////////////
+// Bits
+
+typedef std::vector<BigUInt> BitWordList;
+
+const BigInt NUM_BITS_PER_WORD = 64;
+
+BigInt CountSetBits(BigUInt value)
+{
+#ifdef _MSC_VER
+    return (BigInt)__popcnt64(value);
+#else
+    return (BigInt)__builtin_popcountll(value);
+#endif
+}
+
+BigInt FindLowestSetBit(BigUInt value)
+{
+    assert(value != 0);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (BigInt)index;
+#else
+    return (BigInt)__builtin_ctzll(value);
+#endif
+}
+
+BigInt FindHighestSetBit(BigUInt value)
+{
+    assert(value != 0);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (BigInt)index;
+#else
+    return (BigInt)(63 - __builtin_clzll(value));
+#endif
+}
+
+// these return the number of bits in words if there's no such bit at or after fromBit
+
+BigInt FindNextSetBit(const BitWordList& words, BigInt fromBit)
+{
+    const BigInt numBits = (BigInt)words.size() * NUM_BITS_PER_WORD;
+    if (fromBit >= numBits)
+        return numBits;
+
+    BigInt wordIndex = fromBit / NUM_BITS_PER_WORD;
+    BigUInt word = words[wordIndex] & (~0ULL << (fromBit % NUM_BITS_PER_WORD));
+    while (word == 0)
+    {
+        if (++wordIndex == (BigInt)words.size())
+            return numBits;
+        word = words[wordIndex];
+    }
+    return wordIndex * NUM_BITS_PER_WORD + FindLowestSetBit(word);
+}
+
+BigInt FindNextClearBit(const BitWordList& words, BigInt fromBit)
+{
+    const BigInt numBits = (BigInt)words.size() * NUM_BITS_PER_WORD;
+    if (fromBit >= numBits)
+        return numBits;
+
+    BigInt wordIndex = fromBit / NUM_BITS_PER_WORD;
+    BigUInt word = ~words[wordIndex] & (~0ULL << (fromBit % NUM_BITS_PER_WORD));
+    while (word == 0)
+    {
+        if (++wordIndex == (BigInt)words.size())
+            return numBits;
+        word = ~words[wordIndex];
+    }
+    return wordIndex * NUM_BITS_PER_WORD + FindLowestSetBit(word);
+}
+
+
+////////////////////////////
+// Checked Arithmetic
+
+// these return false (leaving result untouched) if the operation would overflow
+
+bool CheckedAdd(BigInt lhs, BigInt rhs, BigInt& result)
+{
+    if ((rhs > 0) ? (lhs > (MAX_BIG_INT - rhs)) : (lhs < (MIN_BIG_INT - rhs)))
+        return false;
+
+    result = lhs + rhs;
+    return true;
+}
+
+bool CheckedMultiply(BigInt lhs, BigInt rhs, BigInt& result)
+{
+#ifdef _MSC_VER
+    BigInt high;
+    const BigInt low = _mul128(lhs, rhs, &high);
+    if (high != (low >> 63))
+        return false;
+    result = low;
+    return true;
+#else
+    BigInt product;
+    if (__builtin_mul_overflow(lhs, rhs, &product))
+        return false;
+    result = product;
+    return true;
+#endif
+}
+
+// expects lhs and rhs to already be in [0, modulus)
+BigInt AddModulo(BigInt lhs, BigInt rhs, BigInt modulus)
+{
+    assert(modulus > 0);
+    assert((lhs >= 0) && (lhs < modulus) && (rhs >= 0) && (rhs < modulus));
+    return (lhs >= (modulus - rhs)) ? (lhs - (modulus - rhs)) : (lhs + rhs);
+}
+
+// expects lhs and rhs to already be in [0, modulus)
+BigInt MultiplyModulo(BigInt lhs, BigInt rhs, BigInt modulus)
+{
+    assert(modulus > 0);
+    assert((lhs >= 0) && (lhs < modulus) && (rhs >= 0) && (rhs < modulus));
+#ifdef _MSC_VER
+    BigUInt high;
+    const BigUInt low = _umul128((BigUInt)lhs, (BigUInt)rhs, &high);
+    BigUInt remainder;
+    _udiv128(high, low, (BigUInt)modulus, &remainder);
+    return (BigInt)remainder;
+#else
+    return (BigInt)(((unsigned __int128)lhs * (BigUInt)rhs) % (BigUInt)modulus);
+#endif
+}
+
+
+////////////////////////////
+// Threads
+
+// Holds each thread that calls Wait until numThreads threads have, then releases them all;  can be reused right away.
+class ThreadBarrier
+{
+public:
+    ThreadBarrier(BigInt numThreads) : m_numThreads(numThreads), m_numWaiting(0), m_generation(0) {}
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const BigInt generation = m_generation;
+        if (++m_numWaiting == m_numThreads)
+        {
+            m_numWaiting = 0;
+            ++m_generation;
+            m_condition.notify_all();
+        }
+        else
+        {
+            m_condition.wait(lock, [&]() { return m_generation != generation; });
+        }
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    BigInt m_numThreads;
+    BigInt m_numWaiting;
+    BigInt m_generation;
+};
+
+// Runs a double-buffered grid simulation until a generation changes nothing, with the rows split into one band per
+// thread.  The threads live for the whole run:  each generation, every thread calls
+// stepBand(rowBegin, rowEnd, numSetInBand), which writes its band of the next generation from the previous one and
+// returns true if anything in it changed, then after a barrier one thread sums the bands' results and calls
+// finishGeneration() to swap the buffers.  Returns the sum of numSetInBand over the last generation.
+template<typename StepBandFunc, typename FinishGenerationFunc>
+BigInt StepRowBandsUntilNothingChanges(
+    BigInt numRows, BigInt numThreads, StepBandFunc stepBand, FinishGenerationFunc finishGeneration)
+{
+    if (numThreads <= 0)
+        numThreads = std::max<BigInt>(1, std::thread::hardware_concurrency());
+    numThreads = std::max<BigInt>(1, std::min(numThreads, numRows));
+
+    ThreadBarrier barrier(numThreads);
+    // one slot per band, so no two threads write the same byte
+    std::vector<uint8_t> bandsChanged(numThreads, 0);
+    BigIntList bandsNumSet(numThreads, 0);
+    bool done = false;
+    BigInt numSet = 0;
+
+    auto stepBands = [&](BigInt threadIndex) {
+        const BigInt rowBegin = numRows * threadIndex / numThreads;
+        const BigInt rowEnd = numRows * (threadIndex + 1) / numThreads;
+        for (;;)
+        {
+            bandsChanged[threadIndex] = stepBand(rowBegin, rowEnd, bandsNumSet[threadIndex]) ? 1 : 0;
+            barrier.Wait();
+
+            if (threadIndex == 0)
+            {
+                bool somethingChanged = false;
+                numSet = 0;
+                for (BigInt i = 0; i < numThreads; ++i)
+                {
+                    somethingChanged |= (bandsChanged[i] != 0);
+                    numSet += bandsNumSet[i];
+                }
+                finishGeneration();
+                done = !somethingChanged;
+            }
+            barrier.Wait();
+
+            if (done)
+                break;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (BigInt threadIndex = 1; threadIndex < numThreads; ++threadIndex)
+        threads.emplace_back(stepBands, threadIndex);
+    stepBands(0);
+    for (std::thread& thread: threads)
+        thread.join();
+
+    return numSet;
+}
+
+
 ////////////////////////////
 // Factorization
 
@@ -221,6 +459,71 @@ void ReadFileLines(const char* fileName, StringList& lines)
     fclose(pFile);
 }
 
+static bool SeekFile(FILE* pFile, BigInt offset, int origin)
+{
+#ifdef _MSC_VER
+    return _fseeki64(pFile, offset, origin) == 0;
+#else
+    return fseeko(pFile, (off_t)offset, origin) == 0;
+#endif
+}
+
+BigInt GetFileSize(const char* fileName)
+{
+    std::string fullFileName = fileNameBase;
+    fullFileName += fileName;
+    FILE* pFile = fopen(fullFileName.c_str(), "rb");
+    assert(pFile);
+
+    SeekFile(pFile, 0, SEEK_END);
+#ifdef _MSC_VER
+    const BigInt fileSize = _ftelli64(pFile);
+#else
+    const BigInt fileSize = (BigInt)ftello(pFile);
+#endif
+    fclose(pFile);
+    return fileSize;
+}
+
+// Calls func(line) for each non-empty line that starts in [beginOffset, endOffset) of the file, without its line
+// ending, so that threads can each read their own part of a big file.  Lines are at most 1023 characters, like
+// ReadFileLines.
+template<typename LineFunc>
+void ForEachFileLineInRange(const char* fileName, BigInt beginOffset, BigInt endOffset, LineFunc func)
+{
+    std::string fullFileName = fileNameBase;
+    fullFileName += fileName;
+    FILE* pFile = fopen(fullFileName.c_str(), "rb");
+    assert(pFile);
+
+    // a line that starts before beginOffset belongs to an earlier range
+    BigInt offset = beginOffset;
+    if (beginOffset > 0)
+    {
+        SeekFile(pFile, beginOffset - 1, SEEK_SET);
+        offset = beginOffset - 1;
+        for (int c = fgetc(pFile); c != EOF; c = fgetc(pFile))
+        {
+            ++offset;
+            if (c == '\n')
+                break;
+        }
+    }
+
+    char string[1024];
+    while ((offset < endOffset) && fgets(string, sizeof(string), pFile))
+    {
+        BigInt len = strlen(string);
+        offset += len;
+        while ((len > 0) && ((string[len - 1] == '\n') || (string[len - 1] == '\r')))
+            string[--len] = 0;
+        if (len > 0)
+            func(string);
+    }
+
+    fclose(pFile);
+}
+
 void Tokenize(const std::string& st, StringList& tokens, char delim)
 {
     std::stringstream stream(st);
@@ -379,6 +682,7 @@ public:
     BigInt GetCapacity() const { return CAPACITY; }
     BigInt GetSize() const { return m_numInBuffer; }
     bool IsEmpty() const { return m_numInBuffer == 0; }
+    bool IsFull() const { return m_numInBuffer == CAPACITY; }
 
     void Clear() { m_numInBuffer = m_readIndex = m_writeIndex = 0; }
 
@@ -475,7 +779,7 @@ public:
     size_t size() const { return GetSize(); }
     void resize(size_t newSize)
     {
-        const BigInt sizeDiff = (BigInt)newSize - GetSize();
+        BigInt sizeDiff = (BigInt)newSize - GetSize();
         if (sizeDiff > 0)
         {
             while (sizeDiff > 0)
@@ -1188,6 +1492,143 @@ BigInt FindMySeatID(const std::set<BigInt>& seatIDs)
     return mySeatID;
 }
 
+class SeatOccupancyIndex
+{
+public:
+    static const BigInt NUM_SEAT_IDS = 128 * 8;
+
+    SeatOccupancyIndex(BigInt numSeatIDs = NUM_SEAT_IDS)
+        : m_occupiedWords((numSeatIDs + NUM_BITS_PER_WORD - 1) / NUM_BITS_PER_WORD, 0), m_numSeatIDs(numSeatIDs), m_numOccupied(0)
+    {
+        assert(numSeatIDs > 0);
+    }
+
+    void Clear()
+    {
+        std::fill(m_occupiedWords.begin(), m_occupiedWords.end(), 0);
+        m_numOccupied = 0;
+    }
+
+    BigInt GetNumSeatIDs() const { return m_numSeatIDs; }
+    BigInt GetNumOccupied() const { return m_numOccupied; }
+
+    bool IsOccupied(BigInt seatID) const
+    {
+        assert((seatID >= 0) && (seatID < m_numSeatIDs));
+        return (m_occupiedWords[seatID / NUM_BITS_PER_WORD] & CalcSeatBit(seatID)) != 0;
+    }
+
+    bool CheckIn(BigInt seatID)
+    {
+        assert((seatID >= 0) && (seatID < m_numSeatIDs));
+        BigUInt& word = m_occupiedWords[seatID / NUM_BITS_PER_WORD];
+        const BigUInt bit = CalcSeatBit(seatID);
+        if (word & bit)
+            return false;
+
+        word |= bit;
+        ++m_numOccupied;
+        return true;
+    }
+
+    bool CheckOut(BigInt seatID)
+    {
+        assert((seatID >= 0) && (seatID < m_numSeatIDs));
+        BigUInt& word = m_occupiedWords[seatID / NUM_BITS_PER_WORD];
+        const BigUInt bit = CalcSeatBit(seatID);
+        if (!(word & bit))
+            return false;
+
+        word &= ~bit;
+        --m_numOccupied;
+        return true;
+    }
+
+    BigInt FindSmallestSeatID() const
+    {
+        for (BigInt wordIndex = 0; wordIndex < (BigInt)m_occupiedWords.size(); ++wordIndex)
+        {
+            const BigUInt word = m_occupiedWords[wordIndex];
+            if (word)
+                return (wordIndex * NUM_BITS_PER_WORD) + FindLowestSetBit(word);
+        }
+
+        return -1;
+    }
+
+    BigInt FindLargestSeatID() const
+    {
+        for (BigInt wordIndex = (BigInt)m_occupiedWords.size() - 1; wordIndex >= 0; --wordIndex)
+        {
+            const BigUInt word = m_occupiedWords[wordIndex];
+            if (word)
+                return (wordIndex * NUM_BITS_PER_WORD) + FindHighestSetBit(word);
+        }
+
+        return -1;
+    }
+
+    // finds the first free seat whose neighbors on both sides are occupied
+    BigInt FindFirstGapSeatID() const
+    {
+        const BigInt numWords = (BigInt)m_occupiedWords.size();
+        for (BigInt wordIndex = 0; wordIndex < numWords; ++wordIndex)
+        {
+            const BigUInt word = m_occupiedWords[wordIndex];
+            const BigUInt prevWord = (wordIndex > 0) ? m_occupiedWords[wordIndex - 1] : 0;
+            const BigUInt nextWord = (wordIndex < (numWords - 1)) ? m_occupiedWords[wordIndex + 1] : 0;
+
+            // bit i of these is set if seat i-1 (or i+1, respectively) is occupied
+            const BigUInt lowerOccupied = (word << 1) | (prevWord >> (NUM_BITS_PER_WORD - 1));
+            const BigUInt upperOccupied = (word >> 1) | (nextWord << (NUM_BITS_PER_WORD - 1));
+
+            const BigUInt gaps = ~word & lowerOccupied & upperOccupied & CalcValidWordMask(wordIndex);
+            if (gaps)
+                return (wordIndex * NUM_BITS_PER_WORD) + FindLowestSetBit(gaps);
+        }
+
+        return -1;
+    }
+
+    void FindFreeSeatIDs(BigIntList& freeSeatIDs) const
+    {
+        freeSeatIDs.clear();
+        for (BigInt wordIndex = 0; wordIndex < (BigInt)m_occupiedWords.size(); ++wordIndex)
+        {
+            BigUInt freeBits = ~m_occupiedWords[wordIndex] & CalcValidWordMask(wordIndex);
+            while (freeBits)
+            {
+                freeSeatIDs.push_back((wordIndex * NUM_BITS_PER_WORD) + FindLowestSetBit(freeBits));
+                freeBits &= (freeBits - 1);
+            }
+        }
+    }
+
+private:
+    static BigUInt CalcSeatBit(BigInt seatID) { return 1ULL << (seatID % NUM_BITS_PER_WORD); }
+
+    BigUInt CalcValidWordMask(BigInt wordIndex) const
+    {
+        const BigInt numValidBits = m_numSeatIDs - (wordIndex * NUM_BITS_PER_WORD);
+        if (numValidBits >= NUM_BITS_PER_WORD)
+            return ~0ULL;
+        return (1ULL << numValidBits) - 1;
+    }
+
+    BitWordList m_occupiedWords;
+    BigInt m_numSeatIDs;
+    BigInt m_numOccupied;
+};
+
+void CalcSeatIDs(const StringList& data, SeatOccupancyIndex& seatIndex)
+{
+    seatIndex.Clear();
+    for (BigInt i = 0; i < (BigInt)data.size(); ++i)
+    {
+        seatIndex.CheckIn(CalcBoardingPassSeatID(data[i].c_str(), false));
+    }
+}
+
 void RunBinaryBoarding()
 {
     CalcBoardingPassSeatID("FBFBBFFRLR", true);
@@ -1203,6 +1644,24 @@ void RunBinaryBoarding()
     printf("Largest seat ID = %lld\n", FindLargestSeatID(seatIDs));
 
     printf("My seat ID = %lld\n", FindMySeatID(seatIDs));
+
+    SeatOccupancyIndex seatIndex;
+    CalcSeatIDs(data, seatIndex);
+    printf(
+        "Seat index:  %lld occupied, smallest seat ID = %lld, largest seat ID = %lld, my seat ID = %lld\n",
+        seatIndex.GetNumOccupied(),
+        seatIndex.FindSmallestSeatID(),
+        seatIndex.FindLargestSeatID(),
+        seatIndex.FindFirstGapSeatID());
+
+    BigIntList freeSeatIDs;
+    seatIndex.FindFreeSeatIDs(freeSeatIDs);
+    printf("Seat index has %lld free seats\n", (BigInt)freeSeatIDs.size());
+
+    const BigInt mySeatID = seatIndex.FindFirstGapSeatID();
+    seatIndex.CheckIn(mySeatID);
+    printf("After checking in to my seat, next gap seat ID = %lld\n", seatIndex.FindFirstGapSeatID());
+    seatIndex.CheckOut(mySeatID);
 }
 
 
@@ -1283,74 +1742,299 @@ BigInt CalcSumQuestionCountsEveryone(const StringList& data, bool verbose)
     return sum;
 }
 
-void RunCustomCustoms()
-{
-    StringList testData;
-    ReadFileLines("Day6TestInput.txt", testData);
-    printf("Sum question counts (anyone style) of test data = %lld\n", CalcSumQuestionCountsAnyone(testData, false));
-    printf("Sum question counts (everyone style) of test data = %lld\n", CalcSumQuestionCountsEveryone(testData, true));
-
-    StringList data;
-    ReadFileLines("Day6Input.txt", data);
-    printf("Sum question counts (anyone style) = %lld\n", CalcSumQuestionCountsAnyone(data, false));
-    printf("Sum question counts (everyone style) = %lld\n", CalcSumQuestionCountsEveryone(data, false));
-}
-
+const BigInt NUM_CUSTOMS_QUESTIONS = 26;
 
+typedef uint32_t CustomsAnswerMask;
 
-////////////////////////////
-// Problem 7 - Handy Haversacks
+CustomsAnswerMask CalcCustomsAnswerMask(const std::string& answers)
+{
+    CustomsAnswerMask mask = 0;
+    for (const char ch: answers)
+    {
+        assert((ch >= 'a') && (ch <= 'z'));
+        mask |= (1u << (ch - 'a'));
+    }
+    return mask;
+}
 
-struct Haversack
+struct CustomsAnswerSummary
 {
-    std::string type;
-    std::map<std::string, BigInt> contains;
-    std::set<std::string> canBeContainedBy;
+    BigInt numGroups;
+    BigInt numPeople;
+    BigInt sumAnyone;
+    BigInt sumEveryone;
+    // number of groups in which anyone (or everyone, respectively) answered each question
+    BigInt questionCountsAnyone[NUM_CUSTOMS_QUESTIONS];
+    BigInt questionCountsEveryone[NUM_CUSTOMS_QUESTIONS];
 };
 
-const Haversack& GetConstHaversackFromData(const std::map<std::string, Haversack>& data, const std::string& type)
+void AccumulateCustomsQuestionCounts(CustomsAnswerMask mask, BigInt* questionCounts)
 {
-    auto findHaver = data.find(type);
-    assert(findHaver != data.end());
-
-    return findHaver->second;
+    while (mask)
+    {
+        ++questionCounts[FindLowestSetBit(mask)];
+        mask &= (mask - 1);
+    }
 }
 
-Haversack& GetHaversackFromData(std::map<std::string, Haversack>& data, const std::string& type)
+void FinishCustomsGroup(CustomsAnswerMask anyoneMask, CustomsAnswerMask everyoneMask, CustomsAnswerSummary& summary)
 {
-    auto insertHaver = data.insert(std::pair<std::string, Haversack>(type, Haversack()));
-    auto nodeIter = insertHaver.first;
-    Haversack& rHaversack = nodeIter->second;
-    if (insertHaver.second)
-        rHaversack.type = type;
-    return rHaversack;
+    ++summary.numGroups;
+    summary.sumAnyone += CountSetBits(anyoneMask);
+    summary.sumEveryone += CountSetBits(everyoneMask);
+    AccumulateCustomsQuestionCounts(anyoneMask, summary.questionCountsAnyone);
+    AccumulateCustomsQuestionCounts(everyoneMask, summary.questionCountsEveryone);
 }
 
-void ReadHaversackData(const char* fileName, std::map<std::string, Haversack>& data)
+void SummarizeCustomsAnswers(const StringList& data, CustomsAnswerSummary& summary)
 {
-    data.clear();
+    summary = CustomsAnswerSummary();
 
-    StringList lines;
-    ReadFileLines(fileName, lines);
+    CustomsAnswerMask anyoneMask = 0;
+    CustomsAnswerMask everyoneMask = ~0u;
+    bool groupHasPeople = false;
 
-    StringList tokens;
-    for (BigInt i = 0; i < (BigInt)lines.size(); ++i)
+    for (BigInt i = 0; i < (BigInt)data.size(); ++i)
     {
-        Tokenize(lines[i], tokens, ' ');
+        if (data[i].empty())
+        {
+            if (groupHasPeople)
+                FinishCustomsGroup(anyoneMask, everyoneMask, summary);
+            anyoneMask = 0;
+            everyoneMask = ~0u;
+            groupHasPeople = false;
+        }
+        else
+        {
+            const CustomsAnswerMask personMask = CalcCustomsAnswerMask(data[i]);
+            anyoneMask |= personMask;
+            everyoneMask &= personMask;
+            groupHasPeople = true;
+            ++summary.numPeople;
+        }
+    }
 
-        assert(tokens.size() >= 7);
-        const std::string type = tokens[0] + ' ' + tokens[1];
+    if (groupHasPeople)
+        FinishCustomsGroup(anyoneMask, everyoneMask, summary);
+}
 
-        Haversack& thisHaversack = GetHaversackFromData(data, type);
+void PrintCustomsAnswerSummary(const CustomsAnswerSummary& summary)
+{
+    printf(
+        "%lld groups, %lld people, sum question counts (anyone style) = %lld, (everyone style) = %lld\n",
+        summary.numGroups,
+        summary.numPeople,
+        summary.sumAnyone,
+        summary.sumEveryone);
+    printf("  Per question, number of groups (anyone/everyone):  ");
+    for (BigInt i = 0; i < NUM_CUSTOMS_QUESTIONS; ++i)
+        printf("%c=%lld/%lld ", (char)('a' + i), summary.questionCountsAnyone[i], summary.questionCountsEveryone[i]);
+    printf("\n");
+}
 
-        assert(tokens[2] == "bags");
-        assert(tokens[3] == "contain");
+class CustomsSurvey
+{
+public:
+    CustomsSurvey(const StringList& data)
+    {
+        m_groupOffsets.push_back(0);
+        for (BigInt i = 0; i < (BigInt)data.size(); ++i)
+        {
+            if (data[i].empty())
+                FinishGroup();
+            else
+                m_personMasks.push_back(CalcCustomsAnswerMask(data[i]));
+        }
+        FinishGroup();
+    }
 
-        if (tokens[4] == "no")
-            continue;
+    BigInt GetNumGroups() const { return (BigInt)m_groupAnyoneMasks.size(); }
+    BigInt GetNumPeople() const { return (BigInt)m_personMasks.size(); }
+    BigInt GetGroupSize(BigInt groupIndex) const { return m_groupOffsets[groupIndex + 1] - m_groupOffsets[groupIndex]; }
+    CustomsAnswerMask GetGroupAnyoneMask(BigInt groupIndex) const { return m_groupAnyoneMasks[groupIndex]; }
+    CustomsAnswerMask GetGroupEveryoneMask(BigInt groupIndex) const { return m_groupEveryoneMasks[groupIndex]; }
 
-        BigInt index = 4;
-        while ((tokens.size() - index) >= 4)
+    BigInt CalcSumQuestionCountsAnyone() const { return SumSetBits(m_groupAnyoneMasks); }
+    BigInt CalcSumQuestionCountsEveryone() const { return SumSetBits(m_groupEveryoneMasks); }
+
+    // number of people who answered each question
+    void CalcQuestionFrequencies(BigIntList& frequencies) const
+    {
+        frequencies.clear();
+        frequencies.resize(NUM_CUSTOMS_QUESTIONS, 0);
+
+        const BigInt numPeople = GetNumPeople();
+        const CustomsAnswerMask* pMasks = m_personMasks.data();
+        for (BigInt question = 0; question < NUM_CUSTOMS_QUESTIONS; ++question)
+        {
+            BigInt count = 0;
+            for (BigInt i = 0; i < numPeople; ++i)
+                count += (pMasks[i] >> question) & 1;
+            frequencies[question] = count;
+        }
+    }
+
+    // maps group size to number of groups of that size
+    void CalcGroupSizeHistogram(BigIntMap& histogram) const
+    {
+        histogram.clear();
+        for (BigInt groupIndex = 0; groupIndex < GetNumGroups(); ++groupIndex)
+            ++histogram[GetGroupSize(groupIndex)];
+    }
+
+    void FindGroupsWhereEveryoneAnswered(CustomsAnswerMask questions, BigIntList& groupIndices) const
+    {
+        groupIndices.clear();
+        for (BigInt groupIndex = 0; groupIndex < GetNumGroups(); ++groupIndex)
+        {
+            if ((m_groupEveryoneMasks[groupIndex] & questions) == questions)
+                groupIndices.push_back(groupIndex);
+        }
+    }
+
+private:
+    void FinishGroup()
+    {
+        const BigInt groupStart = m_groupOffsets.back();
+        const BigInt groupEnd = GetNumPeople();
+        if (groupEnd == groupStart)
+            return;
+
+        CustomsAnswerMask anyoneMask = 0;
+        CustomsAnswerMask everyoneMask = ~0u;
+        for (BigInt i = groupStart; i < groupEnd; ++i)
+        {
+            anyoneMask |= m_personMasks[i];
+            everyoneMask &= m_personMasks[i];
+        }
+
+        m_groupOffsets.push_back(groupEnd);
+        m_groupAnyoneMasks.push_back(anyoneMask);
+        m_groupEveryoneMasks.push_back(everyoneMask);
+    }
+
+    static BigInt SumSetBits(const std::vector<CustomsAnswerMask>& masks)
+    {
+        BigInt sum = 0;
+        for (const CustomsAnswerMask mask: masks)
+            sum += CountSetBits(mask);
+        return sum;
+    }
+
+    std::vector<CustomsAnswerMask> m_personMasks;
+    // person index range of each group is [m_groupOffsets[i], m_groupOffsets[i + 1])
+    BigIntList m_groupOffsets;
+    std::vector<CustomsAnswerMask> m_groupAnyoneMasks;
+    std::vector<CustomsAnswerMask> m_groupEveryoneMasks;
+};
+
+void PrintCustomsSurveyStats(const CustomsSurvey& survey)
+{
+    printf(
+        "Survey has %lld groups, %lld people, sum question counts (anyone style) = %lld, (everyone style) = %lld\n",
+        survey.GetNumGroups(),
+        survey.GetNumPeople(),
+        survey.CalcSumQuestionCountsAnyone(),
+        survey.CalcSumQuestionCountsEveryone());
+
+    BigIntList frequencies;
+    survey.CalcQuestionFrequencies(frequencies);
+    printf("  Number of people who answered each question:  ");
+    for (BigInt i = 0; i < NUM_CUSTOMS_QUESTIONS; ++i)
+        printf("%c=%lld ", (char)('a' + i), frequencies[i]);
+    printf("\n");
+
+    BigIntMap histogram;
+    survey.CalcGroupSizeHistogram(histogram);
+    printf("  Group sizes:  ");
+    for (auto iter = histogram.cbegin(); iter != histogram.cend(); ++iter)
+        printf("%lldn of %lld  ", iter->second, iter->first);
+    printf("\n");
+
+    BigIntList groupIndices;
+    survey.FindGroupsWhereEveryoneAnswered(CalcCustomsAnswerMask("ab"), groupIndices);
+    printf("  Number of groups where everyone answered 'a' and 'b' = %lld\n", (BigInt)groupIndices.size());
+}
+
+void RunCustomCustoms()
+{
+    StringList testData;
+    ReadFileLines("Day6TestInput.txt", testData);
+    printf("Sum question counts (anyone style) of test data = %lld\n", CalcSumQuestionCountsAnyone(testData, false));
+    printf("Sum question counts (everyone style) of test data = %lld\n", CalcSumQuestionCountsEveryone(testData, true));
+
+    StringList data;
+    ReadFileLines("Day6Input.txt", data);
+    printf("Sum question counts (anyone style) = %lld\n", CalcSumQuestionCountsAnyone(data, false));
+    printf("Sum question counts (everyone style) = %lld\n", CalcSumQuestionCountsEveryone(data, false));
+
+    CustomsAnswerSummary summary;
+    SummarizeCustomsAnswers(testData, summary);
+    printf("Test data mask summary:  ");
+    PrintCustomsAnswerSummary(summary);
+    SummarizeCustomsAnswers(data, summary);
+    printf("Main data mask summary:  ");
+    PrintCustomsAnswerSummary(summary);
+
+    PrintCustomsSurveyStats(CustomsSurvey(testData));
+    PrintCustomsSurveyStats(CustomsSurvey(data));
+}
+
+
+
+////////////////////////////
+// Problem 7 - Handy Haversacks
+
+struct Haversack
+{
+    std::string type;
+    std::map<std::string, BigInt> contains;
+    std::set<std::string> canBeContainedBy;
+};
+
+const Haversack& GetConstHaversackFromData(const std::map<std::string, Haversack>& data, const std::string& type)
+{
+    auto findHaver = data.find(type);
+    assert(findHaver != data.end());
+
+    return findHaver->second;
+}
+
+Haversack& GetHaversackFromData(std::map<std::string, Haversack>& data, const std::string& type)
+{
+    auto insertHaver = data.insert(std::pair<std::string, Haversack>(type, Haversack()));
+    auto nodeIter = insertHaver.first;
+    Haversack& rHaversack = nodeIter->second;
+    if (insertHaver.second)
+        rHaversack.type = type;
+    return rHaversack;
+}
+
+void ReadHaversackData(const char* fileName, std::map<std::string, Haversack>& data)
+{
+    data.clear();
+
+    StringList lines;
+    ReadFileLines(fileName, lines);
+
+    StringList tokens;
+    for (BigInt i = 0; i < (BigInt)lines.size(); ++i)
+    {
+        Tokenize(lines[i], tokens, ' ');
+
+        assert(tokens.size() >= 7);
+        const std::string type = tokens[0] + ' ' + tokens[1];
+
+        Haversack& thisHaversack = GetHaversackFromData(data, type);
+
+        assert(tokens[2] == "bags");
+        assert(tokens[3] == "contain");
+
+        if (tokens[4] == "no")
+            continue;
+
+        BigInt index = 4;
+        while ((tokens.size() - index) >= 4)
         {
             const std::string& numString = tokens[index];
             assert(StringHasDigits(numString));
@@ -1447,859 +2131,3490 @@ BigInt CalcHowManyBagsAreContained(const std::map<std::string, Haversack>& data,
     return count;
 }
 
-void RunHandyHaversacks()
+struct HaversackEdge
 {
-    std::map<std::string, Haversack> testData;
-    ReadHaversackData("Day7TestInput.txt", testData);
-    PrintHaversackData(testData);
-
-    std::map<std::string, Haversack> data;
-    ReadHaversackData("Day7Input.txt", data);
-
-    const std::string interestingType = "shiny gold";
-    printf(
-        "Number of bags in test data that can contain '%s' = %lld\n",
-        interestingType.c_str(),
-        CalcHowManyBagsCanContain(testData, interestingType, true));
-    printf(
-        "Number of bags in main data that can contain '%s' = %lld\n",
-        interestingType.c_str(),
-        CalcHowManyBagsCanContain(data, interestingType, false));
-
-    std::map<std::string, Haversack> testDataA;
-    ReadHaversackData("Day7TestInputA.txt", testDataA);
-    PrintHaversackData(testDataA);
-
-    printf(
-        "Number of bags in test data that '%s' contains = %lld\n",
-        interestingType.c_str(),
-        CalcHowManyBagsAreContained(testData, interestingType, true));
-    printf(
-        "Number of bags in test data that '%s' contains = %lld\n",
-        interestingType.c_str(),
-        CalcHowManyBagsAreContained(testDataA, interestingType, true));
-    printf(
-        "Number of bags in main data that '%s' contains = %lld\n",
-        interestingType.c_str(),
-        CalcHowManyBagsAreContained(data, interestingType, false));
-}
-
+    BigInt colorID;
+    BigInt count;
+};
 
-////////////////////////////
-// Problem 8 - Handheld Halting
+typedef std::vector<HaversackEdge> HaversackEdgeList;
+typedef std::unordered_map<BigInt, HaversackEdgeList> HaversackEdgeListMap;
 
-enum class InstructionType
+// a single rule "colorID bags contain edge.count edge.colorID bags"
+struct HaversackRule
 {
-    NOP,
-    ACC,
-    JMP,
+    BigInt colorID;
+    HaversackEdge edge;
 };
 
-struct Instruction
+typedef std::vector<HaversackRule> HaversackRuleList;
+
+enum class HaversackCountState : uint8_t
 {
-    InstructionType type;
-    BigInt arg;
+    UNKNOWN,
+    VALID,
+    OVERFLOWED,
+    IN_CYCLE,   // contains a bag which (eventually) contains itself
 };
 
-class Program
+// Compiled form of the haversack rules:  colors are interned to dense IDs, and the forward ("contains") and
+// reverse ("can be contained by") adjacency are stored as compressed sparse rows.  Rules changed afterwards are
+// patched in place (a count of 0 marks a removed edge) or kept in small per-color lists until the next Compact().
+class HaversackGraph
 {
 public:
-    Program(const char* fileName) : m_nextInstructionIndex(0), m_accumulator(0), m_programTerminated(false)
+    HaversackGraph(const std::map<std::string, Haversack>& data)
     {
-        StringList lines;
-        StringList tokens;
+        m_colorNames.reserve(data.size());
+        for (auto iter = data.cbegin(); iter != data.cend(); ++iter)
+            InternColor(iter->first);
 
-        ReadFileLines(fileName, lines);
-
-        for (BigInt i = 0; i < (BigInt)lines.size(); ++i)
+        HaversackRuleList rules;
+        BigInt colorID = 0;
+        for (auto iter = data.cbegin(); iter != data.cend(); ++iter, ++colorID)
         {
-            Tokenize(lines[i], tokens, ' ');
-            assert(tokens.size() == 2);
-
-            Instruction newInstruction;
-            if (tokens[0] == "nop")
-                newInstruction.type = InstructionType::NOP;
-            else if (tokens[0] == "acc")
-                newInstruction.type = InstructionType::ACC;
-            else
-            {
-                assert(tokens[0] == "jmp");
-                newInstruction.type = InstructionType::JMP;
-            }
-
-            newInstruction.arg = atoi(tokens[1].c_str());
-
-            m_instructions.push_back(newInstruction);
+            for (auto iter2 = iter->second.contains.cbegin(); iter2 != iter->second.contains.cend(); ++iter2)
+                rules.push_back(HaversackRule{ colorID, HaversackEdge{ FindColorID(iter2->first), iter2->second } });
         }
 
-        m_instructionRunCounts.resize(m_instructions.size(), false);
+        BuildRows(rules);
     }
 
-    void ResetExecution()
+    BigInt GetNumColors() const { return (BigInt)m_colorNames.size(); }
+    const std::string& GetColorName(BigInt colorID) const { return m_colorNames[colorID]; }
+
+    BigInt GetNumEdges() const
     {
-        m_nextInstructionIndex = 0;
-        m_accumulator = 0;
-        std::fill(m_instructionRunCounts.begin(), m_instructionRunCounts.end(), false);
-        m_programTerminated = false;
+        BigInt numEdges = 0;
+        for (BigInt colorID = 0; colorID < GetNumColors(); ++colorID)
+            ForEachChild(colorID, [&](const HaversackEdge&) { ++numEdges; });
+        return numEdges;
     }
 
-    BigInt GetAccumulator() const { return m_accumulator; }
-    bool DidProgramTerminate() const { return m_programTerminated; }
+    BigInt FindColorID(const std::string& type) const
+    {
+        auto findIter = m_colorIDs.find(type);
+        return (findIter != m_colorIDs.end()) ? findIter->second : -1;
+    }
 
-    void ExecuteNextInstruction(bool verbose)
+    // Adds, changes or (with a count of 0) removes the rule that one color contains some number of another.  Only
+    // the cached counts depending on that rule are invalidated; they are recomputed when next asked for.
+    void SetContainsRule(const std::string& type, const std::string& otherType, BigInt count)
     {
-        assert(!m_programTerminated);
+        assert(count >= 0);
 
-        const BigInt instructionToExecute = m_nextInstructionIndex;
-        if (instructionToExecute >= (BigInt)m_instructions.size())
+        const BigInt colorID = InternColor(type);
+        const BigInt otherID = InternColor(otherType);
+
+        BigInt prevCount = 0;
+        HaversackEdge* pForwardEdge = FindEdge(colorID, otherID, m_forwardOffsets, m_forwardEdges, m_addedForwardEdges);
+        if (pForwardEdge)
         {
-            assert(instructionToExecute == (BigInt)m_instructions.size());
-            m_programTerminated = true;
-            if (verbose)
-                printf("Program terminated\n");
-            return;
-        }
+            HaversackEdge* pReverseEdge = FindEdge(otherID, colorID, m_reverseOffsets, m_reverseEdges, m_addedReverseEdges);
+            assert(pReverseEdge && (pReverseEdge->count == pForwardEdge->count));
 
-        const Instruction& nextInstruction = m_instructions[instructionToExecute];
-        switch (nextInstruction.type)
+            prevCount = pForwardEdge->count;
+            pForwardEdge->count = count;
+            pReverseEdge->count = count;
+        }
+        else if (count > 0)
         {
-            case InstructionType::NOP:
-            default:
-                assert(nextInstruction.type == InstructionType::NOP);
-                // nothing-doing
-                ++m_nextInstructionIndex;
-                if (verbose)
-                    printf("%lld: NOP %+lld\n", instructionToExecute, nextInstruction.arg);
-                break;
-            case InstructionType::ACC:
-                m_accumulator += nextInstruction.arg;
-                ++m_nextInstructionIndex;
-                if (verbose)
-                    printf(
-                        "%lld: ACC %+lld, %lld = %lld%+lld\n",
-                        instructionToExecute,
-                        nextInstruction.arg,
-                        m_accumulator,
-                        m_accumulator - nextInstruction.arg,
-                        nextInstruction.arg);
-                break;
-            case InstructionType::JMP:
-                m_nextInstructionIndex += nextInstruction.arg;
-                if (verbose)
-                    printf(
-                        "%lld: JMP %+lld, %lld = %lld%+lld\n",
-                        instructionToExecute,
-                        nextInstruction.arg,
-                        m_nextInstructionIndex,
-                        m_nextInstructionIndex - nextInstruction.arg,
-                        nextInstruction.arg);
-                break;
+            m_addedForwardEdges[colorID].push_back(HaversackEdge{ otherID, count });
+            m_addedReverseEdges[otherID].push_back(HaversackEdge{ colorID, count });
         }
-        ++m_instructionRunCounts[instructionToExecute];
-    }
 
-    BigInt HasNextInstructionBeenRunBefore() const
-    {
-        return (m_nextInstructionIndex < (BigInt)m_instructionRunCounts.size())
-               && (m_instructionRunCounts[m_nextInstructionIndex] > 0);
+        if (prevCount == count)
+            return;
+
+        InvalidateContainedCounts(colorID);
+        // a changed count doesn't change who can contain whom, only adding or removing the edge does
+        if ((prevCount == 0) || (count == 0))
+            InvalidateAncestorCounts(otherID);
     }
 
-    void ExecuteUntilLoopsOrTerminates(bool verbose)
+    // folds all rule changes back into the compressed rows
+    void Compact()
     {
-        while (!HasNextInstructionBeenRunBefore() && !DidProgramTerminate())
-            ExecuteNextInstruction(verbose);
+        HaversackRuleList rules;
+        for (BigInt colorID = 0; colorID < GetNumColors(); ++colorID)
+            ForEachChild(colorID, [&](const HaversackEdge& edge) { rules.push_back(HaversackRule{ colorID, edge }); });
 
-        if (verbose && HasNextInstructionBeenRunBefore())
-            printf("Program began to loop\n");
+        BuildRows(rules);
     }
 
-    void FindFix(BigInt& instructionToFix, InstructionType& origInstructionType, BigInt& accumlatorAfterTermination, bool verbose)
+    BigInt CalcHowManyBagsCanContain(BigInt colorID) const
     {
-        for (BigInt i = 0; i < (BigInt)m_instructions.size(); ++i)
-        {
-            Instruction& instruction = m_instructions[i];
-            if (instruction.type == InstructionType::ACC)
-                continue;
-
-            const InstructionType typeBackup = instruction.type;
-            if (instruction.type == InstructionType::NOP)
-            {
-                instruction.type = InstructionType::JMP;
-                if (verbose)
-                    printf("Changing instruction %lld from NOP to JMP\n", i);
-            }
-            else
-            {
-                instruction.type = InstructionType::NOP;
-                if (verbose)
-                    printf("Changing instruction %lld from JMP to NOP\n", i);
-            }
+        assert((colorID >= 0) && (colorID < GetNumColors()));
 
-            ResetExecution();
-            ExecuteUntilLoopsOrTerminates(false);
+        BoolList visited(GetNumColors(), false);
+        BigIntList toVisit;
+        toVisit.push_back(colorID);
 
-            instruction.type = typeBackup;
+        BigInt count = 0;
+        while (!toVisit.empty())
+        {
+            const BigInt thisID = toVisit.back();
+            toVisit.pop_back();
 
-            if (DidProgramTerminate())
-            {
-                instructionToFix = i;
-                origInstructionType = typeBackup;
-                accumlatorAfterTermination = m_accumulator;
-                if (verbose)
-                    printf("Program terminated successfully!!!\n");
-                return;
-            }
+            ForEachParent(thisID, [&](const HaversackEdge& edge) {
+                if (visited[edge.colorID])
+                    return;
 
-            if (verbose)
-                printf("Program began to loop\n");
+                visited[edge.colorID] = true;
+                ++count;
+                toVisit.push_back(edge.colorID);
+            });
         }
 
-        if (verbose)
-        {
-            instructionToFix = -1;
-            origInstructionType = InstructionType::NOP;
-            accumlatorAfterTermination = -1;
-            printf("Fix not found!!!\n");
-        }
+        return count;
     }
 
+    // same as CalcHowManyBagsCanContain, but cached until a rule change affects it
+    BigInt GetHowManyBagsCanContain(BigInt colorID)
+    {
+        assert((colorID >= 0) && (colorID < GetNumColors()));
 
-private:
-    std::vector<Instruction> m_instructions;
-
-    BigInt m_nextInstructionIndex;
-    BigInt m_accumulator;
-    BigIntList m_instructionRunCounts;
-    bool m_programTerminated;
-};
-
-void RunHandheldHalting()
-{
-    Program testProgram("Day8TestInput.txt");
-    printf("Test program, running until loop:\n");
-    testProgram.ExecuteUntilLoopsOrTerminates(true);
-    printf("Accumulator = %lld\n", testProgram.GetAccumulator());
-    printf("Fixing test program\n");
-    BigInt instructionToFix;
-    InstructionType origInstructionType;
-    BigInt accumulatorAfterFix;
-    testProgram.FindFix(instructionToFix, origInstructionType, accumulatorAfterFix, true);
-    printf(
-        "Test program was fixed by changing instruction %lld from %s to %s, allowing program to terminate normally with accumulator = %lld\n",
-        instructionToFix,
-        (origInstructionType == InstructionType::NOP) ? "NOP" : "JMP",
-        (origInstructionType == InstructionType::NOP) ? "JMP" : "NOP",
-        accumulatorAfterFix);
+        if (m_ancestorCounts[colorID] < 0)
+            m_ancestorCounts[colorID] = CalcHowManyBagsCanContain(colorID);
+        return m_ancestorCounts[colorID];
+    }
 
-    Program program("Day8Input.txt");
-    printf("\nMain program, running until loop:\n");
-    program.ExecuteUntilLoopsOrTerminates(false);
-    printf("Accumulator = %lld\n", program.GetAccumulator());
-    printf("Fixing main program\n");
-    program.FindFix(instructionToFix, origInstructionType, accumulatorAfterFix, true);
-    printf(
-        "Main program was fixed by changing instruction %lld from %s to %s, allowing program to terminate normally with accumulator = %lld\n",
-        instructionToFix,
-        (origInstructionType == InstructionType::NOP) ? "NOP" : "JMP",
-        (origInstructionType == InstructionType::NOP) ? "JMP" : "NOP",
-        accumulatorAfterFix);
-}
+    BigInt CalcHowManyBagsAreContained(BigInt colorID) const
+    {
+        assert((colorID >= 0) && (colorID < GetNumColors()));
 
+        BigInt count = 0;
+        ForEachChild(colorID, [&](const HaversackEdge& edge) {
+            count += (edge.count * (1 + CalcHowManyBagsAreContained(edge.colorID)));
+        });
 
-////////////////////////////
-// Problem 9 - Encoding Error
+        return count;
+    }
 
-class XMasNumberSeries
-{
-public:
-    XMasNumberSeries(BigInt windowSize, const char* fileName) : m_windowSize(windowSize)
+    // Computes the contained count of every color in one pass, children before parents.  With a modulus, counts are
+    // kept modulo it instead of being checked for overflow.  Returns false if the rules contain a cycle.
+    bool ComputeContainedCounts(BigInt modulus = 0)
     {
-        StringList lines;
-        ReadFileLines(fileName, lines);
-        for (BigInt i = 0; i < (BigInt)lines.size(); ++i)
+        assert(modulus >= 0);
+
+        m_containedCountModulus = modulus;
+        m_dirtyContainedIDs.clear();
+        for (BigInt colorID = 0; colorID < GetNumColors(); ++colorID)
         {
-            m_numbers.push_back(atoi(lines[i].c_str()));
+            SetContainedCount(colorID, -1, HaversackCountState::UNKNOWN);
+            m_dirtyContainedIDs.push_back(colorID);
         }
+
+        return UpdateContainedCounts();
     }
 
-    BigInt FindFirstInvalidNumber(bool verbose) const
+    // Recomputes only the contained counts invalidated by rule changes, children before parents.  Returns false if
+    // the rules contain a cycle.
+    bool UpdateContainedCounts()
     {
-        std::set<BigInt> rollingSet;
-
-        for (BigInt i = 0; i < m_windowSize; ++i)
-            rollingSet.insert(m_numbers[i]);
-
-        for (BigInt i = m_windowSize; i < (BigInt)m_numbers.size(); ++i)
+        std::unordered_map<BigInt, BigInt> numChildrenRemaining;
+        BigIntList readyIDs;
+        for (const BigInt colorID: m_dirtyContainedIDs)
         {
-            const BigInt thisNumber = m_numbers[i];
+            BigInt numDirtyChildren = 0;
+            ForEachChild(colorID, [&](const HaversackEdge& edge) {
+                if (m_containedCountStates[edge.colorID] == HaversackCountState::UNKNOWN)
+                    ++numDirtyChildren;
+            });
 
-            bool thisNumberIsValid = false;
-            assert(rollingSet.size() == m_windowSize);
-            for (auto iter = rollingSet.cbegin(); iter != rollingSet.cend(); ++iter)
-            {
-                const BigInt firstNumber = *iter;
-                const BigInt secondNumber = thisNumber - firstNumber;
+            numChildrenRemaining[colorID] = numDirtyChildren;
+            if (numDirtyChildren == 0)
+                readyIDs.push_back(colorID);
+        }
 
-                if ((secondNumber <= 0) || (secondNumber < firstNumber))
-                    break;
+        while (!readyIDs.empty())
+        {
+            const BigInt colorID = readyIDs.back();
+            readyIDs.pop_back();
 
-                if (rollingSet.count(secondNumber) > 0)
-                {
-                    thisNumberIsValid = true;
-                    if (verbose)
-                        printf(
-                            "This number %lld is the sum of %lld and %lld, therefore valid\n",
-                            thisNumber,
-                            firstNumber,
-                            secondNumber);
-                    break;
-                }
-            }
+            ComputeContainedCount(colorID);
 
-            if (!thisNumberIsValid)
-                return thisNumber;
+            ForEachParent(colorID, [&](const HaversackEdge& edge) {
+                if ((m_containedCountStates[edge.colorID] == HaversackCountState::UNKNOWN)
+                    && (--numChildrenRemaining[edge.colorID] == 0))
+                    readyIDs.push_back(edge.colorID);
+            });
+        }
 
-            rollingSet.erase(m_numbers[i - m_windowSize]);
-            rollingSet.insert(thisNumber);
-            assert(rollingSet.size() == m_windowSize);
+        // whatever wasn't reached is either in a cycle or contains something in one
+        for (const BigInt colorID: m_dirtyContainedIDs)
+        {
+            if (m_containedCountStates[colorID] == HaversackCountState::UNKNOWN)
+                SetContainedCount(colorID, -1, HaversackCountState::IN_CYCLE);
         }
+        m_dirtyContainedIDs.clear();
 
-        return -1;
+        return (m_numContainedInCycle == 0);
     }
 
-    BigInt FindEncryptionWeakness(BigInt invalidNumber, bool verbose) const
+    BigInt GetContainedCount(BigInt colorID, HaversackCountState* pState = nullptr)
     {
-        assert(invalidNumber = FindFirstInvalidNumber(false));
+        assert((colorID >= 0) && (colorID < GetNumColors()));
 
-        BigInt sum = 0;
-        std::set<BigInt> numbersInSum;
+        if (!m_dirtyContainedIDs.empty())
+            UpdateContainedCounts();
 
-        assert(m_numbers.size() >= 2);
+        const HaversackCountState state = m_containedCountStates[colorID];
+        if (pState)
+            *pState = state;
+        return (state == HaversackCountState::VALID) ? m_containedCounts[colorID] : -1;
+    }
 
-        BigInt firstIndex = 0;
-        BigInt secondIndex = 1;
-        const BigInt firstNumber = m_numbers[firstIndex];
-        const BigInt secondNumber = m_numbers[secondIndex];
+    // Counts, for every color at once, how many colors can eventually contain it.  Each color's containers are a
+    // bitset row built by OR-ing its parents' rows, visiting containers first.  The columns are split into blocks,
+    // which are handed out to worker threads.  Returns false (with no counts) if the rules contain a cycle.
+    bool CalcHowManyBagsCanContainAll(BigIntList& counts, BigInt numThreads = 0) const
+    {
+        const BigInt numColors = GetNumColors();
+        counts.assign(numColors, 0);
 
-        sum = firstNumber + secondNumber;
-        if (sum == invalidNumber)
+        BigIntList order;
+        if (!CalcContainersFirstOrder(order))
         {
-            if (verbose)
-                printf(
-                    "Immediately found encryption weakness with first number = %lld, second number = %lld\n",
-                    firstNumber,
-                    secondNumber);
-            return sum;
+            counts.clear();
+            return false;
         }
+        if (numColors == 0)
+            return true;
 
-        numbersInSum.insert(firstNumber);
-        numbersInSum.insert(secondNumber);
+        const BigInt numBlocks = (numColors + NUM_COLORS_PER_BLOCK - 1) / NUM_COLORS_PER_BLOCK;
+        if (numThreads <= 0)
+            numThreads = std::max<BigInt>(1, std::thread::hardware_concurrency());
+        numThreads = std::min(numThreads, numBlocks);
 
-        if (verbose)
-            printf("Starting with first number = %lld, second number = %lld\n", firstNumber, secondNumber);
+        std::atomic<BigInt> nextBlock(0);
+        std::vector<BigIntList> threadCounts(numThreads);
+        auto countBlocks = [&](BigInt threadIndex) {
+            BigIntList& blockCounts = threadCounts[threadIndex];
+            blockCounts.assign(numColors, 0);
 
-        for (;;)
-        {
-            if (sum < invalidNumber)
+            BitWordList rows(numColors * NUM_WORDS_PER_BLOCK);
+            for (;;)
             {
-                if (secondIndex >= ((BigInt)m_numbers.size() - 1))
-                    return -1;
-
-                ++secondIndex;
-                const BigInt newNumber = m_numbers[secondIndex];
-                sum += newNumber;
-                numbersInSum.insert(newNumber);
+                const BigInt block = nextBlock++;
+                if (block >= numBlocks)
+                    break;
 
-                if (verbose)
+                const BigInt blockStart = block * NUM_COLORS_PER_BLOCK;
+                for (const BigInt colorID: order)
                 {
-                    printf("Added new second number, sum = %lld, sequence is now:  ", sum);
-                    for (BigInt i = firstIndex; i <= secondIndex; ++i)
-                    {
-                        printf("%lld ", m_numbers[i]);
-                    }
-                    printf("\n");
+                    BigUInt* pRow = &rows[colorID * NUM_WORDS_PER_BLOCK];
+                    std::fill(pRow, pRow + NUM_WORDS_PER_BLOCK, 0);
+
+                    ForEachParent(colorID, [&](const HaversackEdge& edge) {
+                        const BigUInt* pParentRow = &rows[edge.colorID * NUM_WORDS_PER_BLOCK];
+                        for (BigInt i = 0; i < NUM_WORDS_PER_BLOCK; ++i)
+                            pRow[i] |= pParentRow[i];
+
+                        const BigInt bitIndex = edge.colorID - blockStart;
+                        if ((bitIndex >= 0) && (bitIndex < NUM_COLORS_PER_BLOCK))
+                            pRow[bitIndex / NUM_BITS_PER_WORD] |= (1ULL << (bitIndex % NUM_BITS_PER_WORD));
+                    });
+
+                    BigInt count = 0;
+                    for (BigInt i = 0; i < NUM_WORDS_PER_BLOCK; ++i)
+                        count += CountSetBits(pRow[i]);
+                    blockCounts[colorID] += count;
                 }
             }
-            else
-            {
-                assert(sum > invalidNumber);
+        };
 
-                const BigInt prevNumber = m_numbers[firstIndex];
-                sum -= prevNumber;
-                numbersInSum.erase(prevNumber);
-                ++firstIndex;
+        std::vector<std::thread> threads;
+        for (BigInt threadIndex = 1; threadIndex < numThreads; ++threadIndex)
+            threads.emplace_back(countBlocks, threadIndex);
+        countBlocks(0);
+        for (std::thread& thread: threads)
+            thread.join();
 
-                if (firstIndex == secondIndex)
-                {
-                    if (secondIndex >= ((BigInt)m_numbers.size() - 1))
-                        return -1;
+        for (const BigIntList& blockCounts: threadCounts)
+        {
+            for (BigInt colorID = 0; colorID < numColors; ++colorID)
+                counts[colorID] += blockCounts[colorID];
+        }
 
-                    ++secondIndex;
-                    const BigInt newNumber = m_numbers[secondIndex];
-                    sum += newNumber;
-                    numbersInSum.insert(newNumber);
+        return true;
+    }
 
-                    if (verbose)
-                    {
-                        printf("Incremented first and second numbers, sum = %lld, sequence is now:  ", sum);
-                        for (BigInt i = firstIndex; i <= secondIndex; ++i)
-                        {
-                            printf("%lld ", m_numbers[i]);
-                        }
-                        printf("\n");
-                    }
-                }
-                else
-                {
-                    if (verbose)
-                    {
-                        printf("Removed first number, sum = %lld, sequence is now:  ", sum);
-                        for (BigInt i = firstIndex; i <= secondIndex; ++i)
-                        {
-                            printf("%lld ", m_numbers[i]);
-                        }
-                        printf("\n");
-                    }
-                }
-            }
+private:
+    static const BigInt NUM_WORDS_PER_BLOCK = 8;
+    static const BigInt NUM_COLORS_PER_BLOCK = NUM_WORDS_PER_BLOCK * NUM_BITS_PER_WORD;
 
-            if (sum == invalidNumber)
-            {
-                assert(numbersInSum.size() >= 2);
-                const BigInt smallest = *numbersInSum.cbegin();
-                const BigInt largest = *numbersInSum.crbegin();
-                const BigInt weakness = smallest + largest;
+    // orders colors so that every color comes after everything that can contain it; returns false if there is a cycle
+    bool CalcContainersFirstOrder(BigIntList& order) const
+    {
+        const BigInt numColors = GetNumColors();
+        order.clear();
+        order.reserve(numColors);
 
-                if (verbose)
-                {
-                    printf(
-                        "Found valid sum = %lld, smallest is %lld, largest is %lld, weakness is %lld, sequence is:  ",
-                        sum,
-                        smallest,
-                        largest,
-                        weakness);
-                    for (BigInt i = firstIndex; i <= secondIndex; ++i)
-                    {
-                        printf("%lld ", m_numbers[i]);
-                    }
-                    printf("\n");
-                }
+        BigIntList numParentsRemaining(numColors, 0);
+        for (BigInt colorID = 0; colorID < numColors; ++colorID)
+        {
+            ForEachParent(colorID, [&](const HaversackEdge&) { ++numParentsRemaining[colorID]; });
+            if (numParentsRemaining[colorID] == 0)
+                order.push_back(colorID);
+        }
 
-                return weakness;
-            }
+        for (BigInt i = 0; i < (BigInt)order.size(); ++i)
+        {
+            ForEachChild(order[i], [&](const HaversackEdge& edge) {
+                if (--numParentsRemaining[edge.colorID] == 0)
+                    order.push_back(edge.colorID);
+            });
         }
 
-        return -1;
+        return ((BigInt)order.size() == numColors);
     }
 
+    BigInt InternColor(const std::string& type)
+    {
+        auto insertIter = m_colorIDs.emplace(type, GetNumColors());
+        if (!insertIter.second)
+            return insertIter.first->second;
 
-private:
-    BigInt m_windowSize;
-    BigIntList m_numbers;
-};
+        const BigInt colorID = GetNumColors();
+        m_colorNames.push_back(type);
+        if (!m_forwardOffsets.empty())
+        {
+            m_forwardOffsets.push_back(m_forwardOffsets.back());
+            m_reverseOffsets.push_back(m_reverseOffsets.back());
+        }
 
-void RunEncodingError()
-{
-    XMasNumberSeries testSeries(5, "Day9TestInput.txt");
-    BigInt firstInvalidNumber = testSeries.FindFirstInvalidNumber(true);
-    printf("First invalid number in test series = %lld\n", firstInvalidNumber);
-    printf("Encryption weakness = %lld\n", testSeries.FindEncryptionWeakness(firstInvalidNumber, true));
+        m_ancestorCounts.push_back(-1);
+        m_containedCounts.push_back(-1);
+        m_containedCountStates.push_back(HaversackCountState::UNKNOWN);
+        m_dirtyContainedIDs.push_back(colorID);
 
-    XMasNumberSeries mainSeries(25, "Day9Input.txt");
-    firstInvalidNumber = mainSeries.FindFirstInvalidNumber(true);
-    printf("First invalid number in main series = %lld\n", firstInvalidNumber);
-    printf("Encryption weakness = %lld\n", mainSeries.FindEncryptionWeakness(firstInvalidNumber, false));
-}
+        return colorID;
+    }
 
+    void BuildRows(const HaversackRuleList& rules)
+    {
+        const BigInt numColors = GetNumColors();
+        m_forwardOffsets.assign(numColors + 1, 0);
+        m_reverseOffsets.assign(numColors + 1, 0);
+        for (const HaversackRule& rule: rules)
+        {
+            ++m_forwardOffsets[rule.colorID + 1];
+            ++m_reverseOffsets[rule.edge.colorID + 1];
+        }
+        for (BigInt i = 0; i < numColors; ++i)
+        {
+            m_forwardOffsets[i + 1] += m_forwardOffsets[i];
+            m_reverseOffsets[i + 1] += m_reverseOffsets[i];
+        }
 
-////////////////////////////
-// Problem 10 - Adapter Array
+        m_forwardEdges.resize(rules.size());
+        m_reverseEdges.resize(rules.size());
 
-void ReadAdapterArray(const char* fileName, std::set<BigInt>& jolts, bool verbose)
-{
-    StringList lines;
-    ReadFileLines(fileName, lines);
+        BigIntList forwardFillIndices(m_forwardOffsets.cbegin(), m_forwardOffsets.cend() - 1);
+        BigIntList reverseFillIndices(m_reverseOffsets.cbegin(), m_reverseOffsets.cend() - 1);
+        for (const HaversackRule& rule: rules)
+        {
+            m_forwardEdges[forwardFillIndices[rule.colorID]++] = rule.edge;
+            m_reverseEdges[reverseFillIndices[rule.edge.colorID]++] = HaversackEdge{ rule.colorID, rule.edge.count };
+        }
 
-    jolts.clear();
-    for (BigInt i = 0; i < (BigInt)lines.size(); ++i)
-    {
-        jolts.insert(atoi(lines[i].c_str()));
+        m_addedForwardEdges.clear();
+        m_addedReverseEdges.clear();
     }
 
-    if (verbose)
+    static HaversackEdge* FindEdge(
+        BigInt fromID, BigInt toID, const BigIntList& offsets, HaversackEdgeList& edges, HaversackEdgeListMap& addedEdges)
     {
-        printf("Read adapter array from '%s', sorted list = ", fileName);
-        for (auto iter = jolts.cbegin(); iter != jolts.cend(); ++iter)
+        for (BigInt i = offsets[fromID]; i < offsets[fromID + 1]; ++i)
         {
-            printf("%lld ", *iter);
+            if (edges[i].colorID == toID)
+                return &edges[i];
         }
-        printf("\n");
-    }
-}
 
-void CalcAdaptorJoltGaps(
-    const std::set<BigInt>& jolts, BigInt& num1JoltGaps, BigInt& num2JoltGaps, BigInt& num3JoltGaps, bool verbose)
-{
-    assert(jolts.size() >= 2);
-    assert(*jolts.cbegin() <= 3);
+        auto findIter = addedEdges.find(fromID);
+        if (findIter != addedEdges.end())
+        {
+            for (HaversackEdge& edge: findIter->second)
+            {
+                if (edge.colorID == toID)
+                    return &edge;
+            }
+        }
 
-    num1JoltGaps = 0;
-    num2JoltGaps = 0;
-    num3JoltGaps = 0;
+        return nullptr;
+    }
 
-    BigInt prevJolt = 0;
-    for (auto iter = jolts.cbegin(); iter != jolts.cend(); ++iter)
+    template<typename FUNC>
+    static void ForEachEdge(
+        BigInt fromID, const BigIntList& offsets, const HaversackEdgeList& edges, const HaversackEdgeListMap& addedEdges, FUNC func)
     {
-        const BigInt thisJolt = *iter;
-        const BigInt joltGap = thisJolt - prevJolt;
-        assert(joltGap >= 1);
-        assert(joltGap <= 3);
+        for (BigInt i = offsets[fromID]; i < offsets[fromID + 1]; ++i)
+        {
+            if (edges[i].count > 0)
+                func(edges[i]);
+        }
 
-        if (joltGap == 1)
-            ++num1JoltGaps;
-        else if (joltGap == 3)
-            ++num3JoltGaps;
+        if (addedEdges.empty())
+            return;
 
-        if (verbose)
+        auto findIter = addedEdges.find(fromID);
+        if (findIter != addedEdges.end())
         {
-            printf("This jolt = %lld, which is a gap %lld from prev jolt %lld\n", thisJolt, joltGap, prevJolt);
-            if (joltGap == 1)
-                printf("Num 1-jolt gaps incremented to %lld\n", num1JoltGaps);
-            else if (joltGap == 2)
-                printf("Num 2-jolt gaps incremented to %lld\n", num2JoltGaps);
-            else if (joltGap == 3)
-                printf("Num 3-jolt gaps incremented to %lld\n", num3JoltGaps);
+            for (const HaversackEdge& edge: findIter->second)
+            {
+                if (edge.count > 0)
+                    func(edge);
+            }
         }
+    }
 
-        prevJolt = thisJolt;
+    template<typename FUNC>
+    void ForEachChild(BigInt colorID, FUNC func) const
+    {
+        ForEachEdge(colorID, m_forwardOffsets, m_forwardEdges, m_addedForwardEdges, func);
     }
 
-    ++num3JoltGaps;
-    if (verbose)
-        printf(
-            "Final 3-jolt gap from %lld to %lld\nFound %lld 1-jolt gaps, %lld 2-jolt gaps, and %lld 3-jolt gaps\n",
-            prevJolt,
-            prevJolt + 3,
-            num1JoltGaps,
-            num2JoltGaps,
-            num3JoltGaps);
-}
+    template<typename FUNC>
+    void ForEachParent(BigInt colorID, FUNC func) const
+    {
+        ForEachEdge(colorID, m_reverseOffsets, m_reverseEdges, m_addedReverseEdges, func);
+    }
 
-BigInt CalcProdAdaptor1JoltAnd3JoltGaps(const std::set<BigInt>& jolts, bool verbose)
-{
-    BigInt num1JoltGaps = 0;
-    BigInt num2JoltGaps = 0;
-    BigInt num3JoltGaps = 0;
-    CalcAdaptorJoltGaps(jolts, num1JoltGaps, num2JoltGaps, num3JoltGaps, verbose);
+    // the counts of this color and everything that can contain it depend on its rules
+    void InvalidateContainedCounts(BigInt colorID)
+    {
+        BigIntList toVisit;
+        toVisit.push_back(colorID);
+        while (!toVisit.empty())
+        {
+            const BigInt thisID = toVisit.back();
+            toVisit.pop_back();
 
-    return num1JoltGaps * num3JoltGaps;
-}
+            // anything already unknown has had its containers invalidated too
+            if (m_containedCountStates[thisID] == HaversackCountState::UNKNOWN)
+                continue;
 
-void IncrementContigAdaptorStretches(BigIntMap& contigStretches, BigInt stretchLen, bool verbose)
-{
-    if (verbose)
-        printf("Finished a contig stretch of length %lld\n", stretchLen);
+            SetContainedCount(thisID, -1, HaversackCountState::UNKNOWN);
+            m_dirtyContainedIDs.push_back(thisID);
 
-    auto contigFinder = contigStretches.find(stretchLen);
-    if (contigFinder != contigStretches.end())
+            ForEachParent(thisID, [&](const HaversackEdge& edge) { toVisit.push_back(edge.colorID); });
+        }
+    }
+
+    // who can contain this color, and everything it contains, depends on its rules
+    void InvalidateAncestorCounts(BigInt colorID)
     {
-        ++(contigFinder->second);
-        if (verbose)
-            printf("Now there are %lld contig stretches of length %lld\n", contigFinder->second, stretchLen);
+        std::unordered_set<BigInt> visited;
+        BigIntList toVisit;
+        toVisit.push_back(colorID);
+        visited.insert(colorID);
+        while (!toVisit.empty())
+        {
+            const BigInt thisID = toVisit.back();
+            toVisit.pop_back();
+
+            m_ancestorCounts[thisID] = -1;
+
+            ForEachChild(thisID, [&](const HaversackEdge& edge) {
+                if (visited.insert(edge.colorID).second)
+                    toVisit.push_back(edge.colorID);
+            });
+        }
     }
-    else
+
+    void SetContainedCount(BigInt colorID, BigInt count, HaversackCountState state)
     {
-        contigStretches.insert(std::pair<BigInt, BigInt>(stretchLen, 1));
-        if (verbose)
-            printf("Now there is 1 contig stretch of length %lld\n", stretchLen);
+        if (m_containedCountStates[colorID] == HaversackCountState::IN_CYCLE)
+            --m_numContainedInCycle;
+        if (state == HaversackCountState::IN_CYCLE)
+            ++m_numContainedInCycle;
+
+        m_containedCounts[colorID] = count;
+        m_containedCountStates[colorID] = state;
     }
-}
 
-void CalcContigAdaptorStretches(const std::set<BigInt>& jolts, BigIntMap& contigStretches, bool verbose)
+    // expects the counts of all children to be computed already
+    void ComputeContainedCount(BigInt colorID)
+    {
+        BigInt count = 0;
+        HaversackCountState state = HaversackCountState::VALID;
+        ForEachChild(colorID, [&](const HaversackEdge& edge) {
+            if (state != HaversackCountState::VALID)
+                return;
+
+            const HaversackCountState childState = m_containedCountStates[edge.colorID];
+            if (childState != HaversackCountState::VALID)
+            {
+                state = childState;
+                return;
+            }
+
+            const BigInt childCount = m_containedCounts[edge.colorID];
+            if (m_containedCountModulus > 0)
+            {
+                const BigInt edgeCount = edge.count % m_containedCountModulus;
+                const BigInt childCountPlusSelf = (childCount + 1) % m_containedCountModulus;
+                count = (count + MultiplyModulo(edgeCount, childCountPlusSelf, m_containedCountModulus)) % m_containedCountModulus;
+            }
+            else
+            {
+                BigInt childCountPlusSelf, term;
+                if (!CheckedAdd(childCount, 1, childCountPlusSelf) || !CheckedMultiply(edge.count, childCountPlusSelf, term)
+                    || !CheckedAdd(count, term, count))
+                    state = HaversackCountState::OVERFLOWED;
+            }
+        });
+
+        SetContainedCount(colorID, (state == HaversackCountState::VALID) ? count : -1, state);
+    }
+
+    StringList m_colorNames;
+    std::unordered_map<std::string, BigInt> m_colorIDs;
+
+    // edges of color i are in [m_forwardOffsets[i], m_forwardOffsets[i + 1]), and likewise for reverse
+    BigIntList m_forwardOffsets;
+    HaversackEdgeList m_forwardEdges;
+    BigIntList m_reverseOffsets;
+    HaversackEdgeList m_reverseEdges;
+    // edges added since the rows were last built
+    HaversackEdgeListMap m_addedForwardEdges;
+    HaversackEdgeListMap m_addedReverseEdges;
+
+    BigIntList m_ancestorCounts;   // -1 if not cached
+
+    BigInt m_containedCountModulus = 0;
+    BigIntList m_containedCounts;
+    std::vector<HaversackCountState> m_containedCountStates;
+    BigIntList m_dirtyContainedIDs;
+    BigInt m_numContainedInCycle = 0;
+};
+
+void RunHandyHaversacks()
 {
-    BigInt num1JoltGaps = 0;
-    BigInt num2JoltGaps = 0;
-    BigInt num3JoltGaps = 0;
-    CalcAdaptorJoltGaps(jolts, num1JoltGaps, num2JoltGaps, num3JoltGaps, false);
+    std::map<std::string, Haversack> testData;
+    ReadHaversackData("Day7TestInput.txt", testData);
+    PrintHaversackData(testData);
 
-    assert(num2JoltGaps == 0);
+    std::map<std::string, Haversack> data;
+    ReadHaversackData("Day7Input.txt", data);
 
-    contigStretches.clear();
-    BigInt currStretchLen = 1;
+    const std::string interestingType = "shiny gold";
+    printf(
+        "Number of bags in test data that can contain '%s' = %lld\n",
+        interestingType.c_str(),
+        CalcHowManyBagsCanContain(testData, interestingType, true));
+    printf(
+        "Number of bags in main data that can contain '%s' = %lld\n",
+        interestingType.c_str(),
+        CalcHowManyBagsCanContain(data, interestingType, false));
 
-    BigInt prevJolt = 0;
-    for (auto iter = jolts.cbegin(); iter != jolts.cend(); ++iter)
-    {
-        const BigInt thisJolt = *iter;
-        const BigInt gap = thisJolt - prevJolt;
+    std::map<std::string, Haversack> testDataA;
+    ReadHaversackData("Day7TestInputA.txt", testDataA);
+    PrintHaversackData(testDataA);
 
-        if (gap == 1)
-        {
-            ++currStretchLen;
-        }
-        else
-        {
-            assert(gap == 3);
+    printf(
+        "Number of bags in test data that '%s' contains = %lld\n",
+        interestingType.c_str(),
+        CalcHowManyBagsAreContained(testData, interestingType, true));
+    printf(
+        "Number of bags in test data that '%s' contains = %lld\n",
+        interestingType.c_str(),
+        CalcHowManyBagsAreContained(testDataA, interestingType, true));
+    printf(
+        "Number of bags in main data that '%s' contains = %lld\n",
+        interestingType.c_str(),
+        CalcHowManyBagsAreContained(data, interestingType, false));
 
-            IncrementContigAdaptorStretches(contigStretches, currStretchLen, verbose);
+    HaversackGraph testGraph(testData);
+    HaversackGraph testGraphA(testDataA);
+    HaversackGraph graph(data);
+    printf(
+        "Compiled graphs:  test data has %lld colors and %lld edges, main data has %lld colors and %lld edges\n",
+        testGraph.GetNumColors(),
+        testGraph.GetNumEdges(),
+        graph.GetNumColors(),
+        graph.GetNumEdges());
+    printf(
+        "Compiled graph, number of bags in test data that can contain '%s' = %lld\n",
+        interestingType.c_str(),
+        testGraph.CalcHowManyBagsCanContain(testGraph.FindColorID(interestingType)));
+    printf(
+        "Compiled graph, number of bags in main data that can contain '%s' = %lld\n",
+        interestingType.c_str(),
+        graph.CalcHowManyBagsCanContain(graph.FindColorID(interestingType)));
+    printf(
+        "Compiled graph, number of bags in test data that '%s' contains = %lld\n",
+        interestingType.c_str(),
+        testGraphA.CalcHowManyBagsAreContained(testGraphA.FindColorID(interestingType)));
+    printf(
+        "Compiled graph, number of bags in main data that '%s' contains = %lld\n",
+        interestingType.c_str(),
+        graph.CalcHowManyBagsAreContained(graph.FindColorID(interestingType)));
 
-            currStretchLen = 1;
-        }
+    const bool testAcyclic = testGraphA.ComputeContainedCounts();
+    const bool mainAcyclic = graph.ComputeContainedCounts();
+    printf(
+        "Memoized counts (%s, %s), number of bags that '%s' contains:  test data = %lld, main data = %lld\n",
+        testAcyclic ? "acyclic" : "cyclic",
+        mainAcyclic ? "acyclic" : "cyclic",
+        interestingType.c_str(),
+        testGraphA.GetContainedCount(testGraphA.FindColorID(interestingType)),
+        graph.GetContainedCount(graph.FindColorID(interestingType)));
 
-        prevJolt = thisJolt;
+    BigInt mostContainingID = 0;
+    for (BigInt colorID = 1; colorID < graph.GetNumColors(); ++colorID)
+    {
+        if (graph.GetContainedCount(colorID) > graph.GetContainedCount(mostContainingID))
+            mostContainingID = colorID;
     }
-    IncrementContigAdaptorStretches(contigStretches, currStretchLen, verbose);
+    printf(
+        "In main data, '%s' contains the most bags = %lld\n",
+        graph.GetColorName(mostContainingID).c_str(),
+        graph.GetContainedCount(mostContainingID));
 
-    if (verbose)
+    graph.ComputeContainedCounts(1000);
+    printf(
+        "Number of bags in main data that '%s' contains, modulo 1000 = %lld\n",
+        interestingType.c_str(),
+        graph.GetContainedCount(graph.FindColorID(interestingType)));
+    graph.ComputeContainedCounts();
+
+    const std::string newType = "sparkly rainbow";
+    const BigInt interestingID = graph.FindColorID(interestingType);
+    graph.SetContainsRule(interestingType, newType, 3);
+    printf(
+        "After adding rule that '%s' contains 3 '%s':  '%s' contains %lld bags, %lld bags can contain '%s'\n",
+        interestingType.c_str(),
+        newType.c_str(),
+        interestingType.c_str(),
+        graph.GetContainedCount(interestingID),
+        graph.GetHowManyBagsCanContain(graph.FindColorID(newType)),
+        newType.c_str());
+
+    HaversackCountState countState;
+    graph.SetContainsRule(newType, interestingType, 1);
+    graph.GetContainedCount(interestingID, &countState);
+    printf(
+        "After adding rule that '%s' contains 1 '%s':  '%s' is %sin a cycle\n",
+        newType.c_str(),
+        interestingType.c_str(),
+        interestingType.c_str(),
+        (countState == HaversackCountState::IN_CYCLE) ? "" : "NOT ");
+
+    graph.SetContainsRule(newType, interestingType, 0);
+    graph.SetContainsRule(interestingType, newType, 0);
+    graph.Compact();
+    printf(
+        "After removing both rules:  '%s' contains %lld bags, %lld bags can contain '%s'\n",
+        interestingType.c_str(),
+        graph.GetContainedCount(interestingID),
+        graph.GetHowManyBagsCanContain(interestingID),
+        interestingType.c_str());
+
+    BigIntList canContainCounts;
+    if (graph.CalcHowManyBagsCanContainAll(canContainCounts))
     {
-        printf("Entire list of stretches:  ");
-        for (auto iter = contigStretches.cbegin(); iter != contigStretches.cend(); ++iter)
-            printf("%lldn of %lld  ", iter->second, iter->first);
-        printf("\n");
+        BigInt numMismatches = 0;
+        BigInt mostContainedID = 0;
+        for (BigInt colorID = 0; colorID < graph.GetNumColors(); ++colorID)
+        {
+            if (canContainCounts[colorID] != graph.CalcHowManyBagsCanContain(colorID))
+                ++numMismatches;
+            if (canContainCounts[colorID] > canContainCounts[mostContainedID])
+                mostContainedID = colorID;
+        }
+        printf(
+            "Closure of all colors in main data:  %lld bags can contain '%s', most containers are for '%s' = %lld, %lld mismatches with single walks\n",
+            canContainCounts[interestingID],
+            interestingType.c_str(),
+            graph.GetColorName(mostContainedID).c_str(),
+            canContainCounts[mostContainedID],
+            numMismatches);
     }
 }
 
-BigInt CalcNumWaysToConnectAdaptors(const std::set<BigInt>& jolts, bool verbose)
+
+////////////////////////////
+// Problem 8 - Handheld Halting
+
+// The instruction set, in one place:  everything else (InstructionType, the parser, both interpreters, and the
+// compiled program's lowering and dispatch) is generated from this list, so adding an instruction is one entry here.
+//
+// X(NAME, mnemonic, operands, control, body)
+//   operands:  how the instruction is written (InstructionOperands)
+//   control:   where execution continues (InstructionControl)
+//   body:      what the instruction does besides that, written with PROGRAM_ACCUMULATOR, PROGRAM_ARG,
+//              PROGRAM_GET_REGISTER, PROGRAM_SET_REGISTER(value) and PROGRAM_MEMORY, which each interpreter defines
+//              before expanding the list
+#define PROGRAM_INSTRUCTION_SET(X)                                                                                      \
+    X(NOP, "nop", ARG, NEXT, {})                                                                                        \
+    X(ACC, "acc", ARG, NEXT, { PROGRAM_ACCUMULATOR += PROGRAM_ARG; })                                                   \
+    X(JMP, "jmp", ARG, JUMP, {})                                                                                        \
+    /* extended instruction set */                                                                                      \
+    X(JEZ, "jez", REGISTER_ARG, JUMP_IF_ZERO, {})                                                                       \
+    X(JNZ, "jnz", REGISTER_ARG, JUMP_IF_NONZERO, {})                                                                    \
+    X(SET, "set", REGISTER_ARG, NEXT, { PROGRAM_SET_REGISTER(PROGRAM_ARG); })                                          \
+    X(ADD, "add", REGISTER_ARG, NEXT, { PROGRAM_SET_REGISTER(PROGRAM_GET_REGISTER + PROGRAM_ARG); })                   \
+    X(LDA, "lda", REGISTER, NEXT, { PROGRAM_ACCUMULATOR = PROGRAM_GET_REGISTER; })                                     \
+    X(STA, "sta", REGISTER, NEXT, { PROGRAM_SET_REGISTER(PROGRAM_ACCUMULATOR); })                                      \
+    X(LDM, "ldm", ADDRESS, NEXT, { PROGRAM_ACCUMULATOR = PROGRAM_MEMORY; })                                            \
+    X(STM, "stm", ADDRESS, NEXT, { PROGRAM_MEMORY = PROGRAM_ACCUMULATOR; })
+
+enum class InstructionType
 {
-    BigIntMap contigStretches;
-    CalcContigAdaptorStretches(jolts, contigStretches, verbose);
+#define PROGRAM_INSTRUCTION_TYPE(NAME, mnemonic, operands, control, body) NAME,
+    PROGRAM_INSTRUCTION_SET(PROGRAM_INSTRUCTION_TYPE)
+#undef PROGRAM_INSTRUCTION_TYPE
+    NUM_INSTRUCTION_TYPES
+};
 
-    BigInt numWays = 1;
+struct Instruction
+{
+    InstructionType type;
+    BigInt arg;
+    BigInt reg;
+};
 
-    for (auto iter = contigStretches.cbegin(); iter != contigStretches.cend(); ++iter)
-    {
-        if (iter->first < 3)
-            continue;
+const BigInt NUM_PROGRAM_REGISTERS = 8;   // register 0 ("acc" or "r0") is the accumulator
+const BigInt NUM_PROGRAM_MEMORY_WORDS = 256;
 
-        BigInt numStretchWays = 1;
-        switch (iter->first)
-        {
-            case 3:
-                numStretchWays = 2;
-                break;
-            case 4:
-                numStretchWays = 4;
-                break;
-            case 5:
-                numStretchWays = 7;
-                break;
-            default:
-                assert(false);
-                break;
-        }
+enum class InstructionOperands
+{
+    ARG,            // "jmp +4"
+    ADDRESS,        // "ldm +7", an arg that must be a memory address
+    REGISTER,       // "lda r1"
+    REGISTER_ARG,   // "add r1 -1"
+};
 
-        const BigInt term = (BigInt)pow((double)numStretchWays, (double)iter->second);
-        if (verbose)
-            printf(
-                "There are %lld stretches of length %lld;  each one contributes %lld ways;  term is %lld ^ %lld;  numWays = numWays * %lld = %lld * %lld = %lld\n",
-                iter->second,
-                iter->first,
-                numStretchWays,
-                numStretchWays,
-                iter->second,
-                term,
-                numWays,
-                term,
-                numWays * term);
+enum class InstructionControl
+{
+    NEXT,              // continue with the next instruction
+    JUMP,              // jump by arg
+    JUMP_IF_ZERO,      // jump by arg if the register is zero, otherwise continue
+    JUMP_IF_NONZERO,   // jump by arg if the register isn't zero, otherwise continue
+};
 
-        numWays *= term;
-    }
+struct InstructionInfo
+{
+    const char* mnemonic;
+    InstructionType type;
+    InstructionOperands operands;
+    InstructionControl control;
+};
 
-    return numWays;
+// indexed by InstructionType
+static const InstructionInfo s_instructionInfos[] = {
+#define PROGRAM_INSTRUCTION_INFO(NAME, mnemonic, operands, control, body)                                               \
+    { mnemonic, InstructionType::NAME, InstructionOperands::operands, InstructionControl::control },
+    PROGRAM_INSTRUCTION_SET(PROGRAM_INSTRUCTION_INFO)
+#undef PROGRAM_INSTRUCTION_INFO
+};
+
+static_assert(
+    sizeof(s_instructionInfos) / sizeof(s_instructionInfos[0]) == (size_t)InstructionType::NUM_INSTRUCTION_TYPES,
+    "s_instructionInfos should have an entry per InstructionType");
+
+const InstructionInfo& GetInstructionInfo(InstructionType type)
+{
+    const InstructionInfo& info = s_instructionInfos[(BigInt)type];
+    assert(info.type == type);
+    return info;
 }
 
-void RunAdapterArray()
+bool IsConditionalJump(InstructionControl control)
 {
-    std::set<BigInt> testJoltsA;
-    ReadAdapterArray("Day10TestInputA.txt", testJoltsA, true);
-    printf("Test array A, product of 1 jolt and 3 jolt gaps = %lld\n", CalcProdAdaptor1JoltAnd3JoltGaps(testJoltsA, true));
-    printf("Test array A, num ways to connect adaptors = %lld\n", CalcNumWaysToConnectAdaptors(testJoltsA, true));
+    return (control == InstructionControl::JUMP_IF_ZERO) || (control == InstructionControl::JUMP_IF_NONZERO);
+}
 
-    std::set<BigInt> testJoltsB;
-    ReadAdapterArray("Day10TestInputB.txt", testJoltsB, true);
-    printf("Test array B, product of 1 jolt and 3 jolt gaps = %lld\n", CalcProdAdaptor1JoltAnd3JoltGaps(testJoltsB, true));
-    printf("Test array B, num ways to connect adaptors = %lld\n", CalcNumWaysToConnectAdaptors(testJoltsB, true));
+// whether an instruction with the given control continues at its jump target rather than the next instruction
+bool IsJumpTaken(InstructionControl control, BigInt registerValue)
+{
+    switch (control)
+    {
+        case InstructionControl::NEXT:
+        default:
+            return false;
+        case InstructionControl::JUMP:
+            return true;
+        case InstructionControl::JUMP_IF_ZERO:
+            return registerValue == 0;
+        case InstructionControl::JUMP_IF_NONZERO:
+            return registerValue != 0;
+    }
+}
 
-    std::set<BigInt> mainJolts;
-    ReadAdapterArray("Day10Input.txt", mainJolts, false);
-    printf("Main array, product of 1 jolt and 3 jolt gaps = %lld\n", CalcProdAdaptor1JoltAnd3JoltGaps(mainJolts, false));
-    printf("Main array, num ways to connect adaptors = %lld\n", CalcNumWaysToConnectAdaptors(mainJolts, true));
+const InstructionInfo* FindInstructionInfo(const std::string& mnemonic)
+{
+    for (const InstructionInfo& info: s_instructionInfos)
+    {
+        if (mnemonic == info.mnemonic)
+            return &info;
+    }
+    return nullptr;
 }
 
+BigInt ParseProgramRegister(const std::string& token)
+{
+    if (token == "acc")
+        return 0;
 
-////////////////////////////
-// Problem 11 - Seating System
+    assert((token.length() >= 2) && (token[0] == 'r') && StringHasDigits(token, 1));
+    const BigInt reg = atoi(token.c_str() + 1);
+    assert(reg < NUM_PROGRAM_REGISTERS);
+    return reg;
+}
 
-class SeatingLayout
+class Program
 {
 public:
-    SeatingLayout(const char* fileName, bool verbose) : m_numSeatsX(0), m_numSeatsY(0)
+    Program(const char* fileName)
+        : m_nextInstructionIndex(0)
+        , m_accumulator(0)
+        , m_registers(NUM_PROGRAM_REGISTERS, 0)
+        , m_memory(NUM_PROGRAM_MEMORY_WORDS, 0)
+        , m_programTerminated(false)
     {
-        ReadFileLines(fileName, m_seats);
+        StringList lines;
+        StringList tokens;
 
-        if (verbose)
-            printf("Read seating layout from %s:\n", fileName);
+        ReadFileLines(fileName, lines);
+
+        for (BigInt i = 0; i < (BigInt)lines.size(); ++i)
+        {
+            Tokenize(lines[i], tokens, ' ');
+            assert(!tokens.empty());
+
+            const InstructionInfo* pInfo = FindInstructionInfo(tokens[0]);
+            assert(pInfo);
+
+            Instruction newInstruction;
+            newInstruction.type = pInfo->type;
+            newInstruction.arg = 0;
+            newInstruction.reg = 0;
+            switch (pInfo->operands)
+            {
+                case InstructionOperands::ARG:
+                case InstructionOperands::ADDRESS:
+                default:
+                    assert(tokens.size() == 2);
+                    newInstruction.arg = atoi(tokens[1].c_str());
+                    break;
+                case InstructionOperands::REGISTER:
+                    assert(tokens.size() == 2);
+                    newInstruction.reg = ParseProgramRegister(tokens[1]);
+                    break;
+                case InstructionOperands::REGISTER_ARG:
+                    assert(tokens.size() == 3);
+                    newInstruction.reg = ParseProgramRegister(tokens[1]);
+                    newInstruction.arg = atoi(tokens[2].c_str());
+                    break;
+            }
 
-        m_numSeatsX = m_seats[0].length();
-        m_numSeatsY = (BigInt)m_seats.size();
-        for (BigInt i = 1; i < m_numSeatsY; ++i)
-            assert(m_seats[i].length() == m_numSeatsX);
+            m_instructions.push_back(newInstruction);
+        }
+
+        m_instructionRunCounts.resize(m_instructions.size(), false);
+    }
+
+    void ResetExecution()
+    {
+        m_nextInstructionIndex = 0;
+        m_accumulator = 0;
+        std::fill(m_registers.begin(), m_registers.end(), 0);
+        std::fill(m_memory.begin(), m_memory.end(), 0);
+        std::fill(m_instructionRunCounts.begin(), m_instructionRunCounts.end(), false);
+        m_programTerminated = false;
+    }
+
+    const std::vector<Instruction>& GetInstructions() const { return m_instructions; }
+    BigInt GetAccumulator() const { return m_accumulator; }
+    bool DidProgramTerminate() const { return m_programTerminated; }
+
+    void ExecuteNextInstruction(bool verbose)
+    {
+        assert(!m_programTerminated);
+
+        const BigInt instructionToExecute = m_nextInstructionIndex;
+        if (instructionToExecute >= (BigInt)m_instructions.size())
+        {
+            assert(instructionToExecute == (BigInt)m_instructions.size());
+            m_programTerminated = true;
+            if (verbose)
+                printf("Program terminated\n");
+            return;
+        }
+
+        const Instruction& nextInstruction = m_instructions[instructionToExecute];
+        // like the compiled program, where a jump goes is decided before the instruction's body runs
+        const bool jumped =
+            IsJumpTaken(GetInstructionInfo(nextInstruction.type).control, GetRegister(nextInstruction.reg));
+        switch (nextInstruction.type)
+        {
+#define PROGRAM_ACCUMULATOR m_accumulator
+#define PROGRAM_ARG nextInstruction.arg
+#define PROGRAM_GET_REGISTER GetRegister(nextInstruction.reg)
+#define PROGRAM_SET_REGISTER(value) SetRegister(nextInstruction.reg, value)
+#define PROGRAM_MEMORY GetMemoryWord(nextInstruction.arg)
+#define PROGRAM_EXECUTE_INSTRUCTION(NAME, mnemonic, operands, control, body)                                            \
+    case InstructionType::NAME:                                                                                         \
+        body break;
+            PROGRAM_INSTRUCTION_SET(PROGRAM_EXECUTE_INSTRUCTION)
+#undef PROGRAM_EXECUTE_INSTRUCTION
+#undef PROGRAM_MEMORY
+#undef PROGRAM_SET_REGISTER
+#undef PROGRAM_GET_REGISTER
+#undef PROGRAM_ARG
+#undef PROGRAM_ACCUMULATOR
+            default:
+                assert(false && "Invalid instruction type");
+                break;
+        }
+
+        m_nextInstructionIndex += jumped ? nextInstruction.arg : 1;
+        if (verbose)
+            PrintInstruction(instructionToExecute, nextInstruction, jumped);
+        ++m_instructionRunCounts[instructionToExecute];
+    }
+
+    BigInt HasNextInstructionBeenRunBefore() const
+    {
+        return (m_nextInstructionIndex < (BigInt)m_instructionRunCounts.size())
+               && (m_instructionRunCounts[m_nextInstructionIndex] > 0);
+    }
+
+    void ExecuteUntilLoopsOrTerminates(bool verbose)
+    {
+        while (!HasNextInstructionBeenRunBefore() && !DidProgramTerminate())
+            ExecuteNextInstruction(verbose);
+
+        if (verbose && HasNextInstructionBeenRunBefore())
+            printf("Program began to loop\n");
+    }
+
+    // the extended instruction set can legitimately run an instruction more than once, so this only stops at the end
+    void ExecuteUntilTerminates(BigInt maxInstructions, bool verbose)
+    {
+        // one more step than maxInstructions, in order to notice termination
+        for (BigInt i = 0; (i <= maxInstructions) && !DidProgramTerminate(); ++i)
+            ExecuteNextInstruction(verbose);
+    }
+
+    void FindFix(BigInt& instructionToFix, InstructionType& origInstructionType, BigInt& accumlatorAfterTermination, bool verbose)
+    {
+        for (BigInt i = 0; i < (BigInt)m_instructions.size(); ++i)
+        {
+            Instruction& instruction = m_instructions[i];
+            if ((instruction.type != InstructionType::NOP) && (instruction.type != InstructionType::JMP))
+                continue;
+
+            const InstructionType typeBackup = instruction.type;
+            if (instruction.type == InstructionType::NOP)
+            {
+                instruction.type = InstructionType::JMP;
+                if (verbose)
+                    printf("Changing instruction %lld from NOP to JMP\n", i);
+            }
+            else
+            {
+                instruction.type = InstructionType::NOP;
+                if (verbose)
+                    printf("Changing instruction %lld from JMP to NOP\n", i);
+            }
+
+            ResetExecution();
+            ExecuteUntilLoopsOrTerminates(false);
+
+            instruction.type = typeBackup;
+
+            if (DidProgramTerminate())
+            {
+                instructionToFix = i;
+                origInstructionType = typeBackup;
+                accumlatorAfterTermination = m_accumulator;
+                if (verbose)
+                    printf("Program terminated successfully!!!\n");
+                return;
+            }
+
+            if (verbose)
+                printf("Program began to loop\n");
+        }
+
+        if (verbose)
+        {
+            instructionToFix = -1;
+            origInstructionType = InstructionType::NOP;
+            accumlatorAfterTermination = -1;
+            printf("Fix not found!!!\n");
+        }
+    }
+
+
+private:
+    BigInt GetRegister(BigInt reg) const { return (reg == 0) ? m_accumulator : m_registers[reg]; }
+    void SetRegister(BigInt reg, BigInt value) { ((reg == 0) ? m_accumulator : m_registers[reg]) = value; }
+
+    BigInt& GetMemoryWord(BigInt address)
+    {
+        assert((address >= 0) && (address < NUM_PROGRAM_MEMORY_WORDS));
+        return m_memory[address];
+    }
+
+    // the base instructions keep their original trace format
+    void PrintInstruction(BigInt instructionIndex, const Instruction& instruction, bool jumped) const
+    {
+        const InstructionInfo& info = GetInstructionInfo(instruction.type);
+        switch (instruction.type)
+        {
+            case InstructionType::NOP:
+                printf("%lld: NOP %+lld\n", instructionIndex, instruction.arg);
+                break;
+            case InstructionType::ACC:
+                printf(
+                    "%lld: ACC %+lld, %lld = %lld%+lld\n",
+                    instructionIndex,
+                    instruction.arg,
+                    m_accumulator,
+                    m_accumulator - instruction.arg,
+                    instruction.arg);
+                break;
+            case InstructionType::JMP:
+                printf(
+                    "%lld: JMP %+lld, %lld = %lld%+lld\n",
+                    instructionIndex,
+                    instruction.arg,
+                    m_nextInstructionIndex,
+                    m_nextInstructionIndex - instruction.arg,
+                    instruction.arg);
+                break;
+            default:
+                if (IsConditionalJump(info.control))
+                    printf(
+                        "%lld: %s r%lld %+lld, %s to %lld\n",
+                        instructionIndex,
+                        info.mnemonic,
+                        instruction.reg,
+                        instruction.arg,
+                        jumped ? "jumped" : "continued",
+                        m_nextInstructionIndex);
+                else
+                    printf(
+                        "%lld: %s r%lld %+lld, accumulator = %lld, register = %lld\n",
+                        instructionIndex,
+                        info.mnemonic,
+                        instruction.reg,
+                        instruction.arg,
+                        m_accumulator,
+                        GetRegister(instruction.reg));
+                break;
+        }
+    }
+
+    std::vector<Instruction> m_instructions;
+
+    BigInt m_nextInstructionIndex;
+    BigInt m_accumulator;
+    BigIntList m_registers;   // m_registers[0] is unused, register 0 is m_accumulator
+    BigIntList m_memory;
+    BigIntList m_instructionRunCounts;
+    bool m_programTerminated;
+};
+
+// the first opcodes match InstructionType
+enum class CompiledOpcode : uint8_t
+{
+#define PROGRAM_COMPILED_OPCODE(NAME, mnemonic, operands, control, body) NAME,
+    PROGRAM_INSTRUCTION_SET(PROGRAM_COMPILED_OPCODE)
+#undef PROGRAM_COMPILED_OPCODE
+    HALT,         // one past the last instruction, i.e. normal termination
+    BAD_JUMP,     // a jump to somewhere other than an instruction or the end of the program
+    BAD_ACCESS,   // a memory access outside of program memory
+};
+
+// dense 8-byte encoding of an instruction
+struct CompiledInstruction
+{
+    int32_t arg;
+    CompiledOpcode opcode;
+    uint8_t reg;
+    uint8_t padding[2];
+};
+
+static_assert(sizeof(CompiledInstruction) == 8, "CompiledInstruction should be 8 bytes");
+
+enum class ProgramOutcome
+{
+    TERMINATED,
+    LOOPED,
+    BAD_JUMP,
+    BAD_ACCESS,
+    OUT_OF_BUDGET,
+};
+
+struct ProgramRunResult
+{
+    ProgramOutcome outcome;
+    BigInt accumulator;
+    BigInt lastInstructionIndex;   // the instruction that would have been run next
+    BigInt numInstructionsExecuted;
+};
+
+struct ProgramTraceEntry
+{
+    int32_t accumulatorDelta;   // CHECKPOINT_DELTA if it didn't fit, see ProgramTrace
+    uint32_t instructionIndex;
+};
+
+static_assert(sizeof(ProgramTraceEntry) == 8, "ProgramTraceEntry should be 8 bytes");
+
+// The most recently executed instructions, oldest first, with how each one changed the accumulator.  Changes that
+// don't fit in an entry are stored as CHECKPOINT_DELTA, with the accumulator after them kept on the side.  Allocate on
+// the heap, it's big.
+class ProgramTrace
+{
+public:
+    static constexpr int32_t CHECKPOINT_DELTA = INT32_MIN;
+
+    ProgramTrace() : m_accumulatorBeforeOldest(0) {}
+
+    BigInt GetSize() const { return m_entries.GetSize(); }
+
+    void Clear()
+    {
+        m_entries.Clear();
+        m_checkpoints.clear();
+        m_accumulatorBeforeOldest = 0;
+    }
+
+    // drops the oldest entry if the trace is full
+    void Record(BigInt instructionIndex, BigInt accumulatorBefore, BigInt accumulatorAfter)
+    {
+        if (m_entries.IsFull())
+            PopOldest();
+
+        ProgramTraceEntry entry;
+        entry.instructionIndex = (uint32_t)instructionIndex;
+        const BigInt delta = accumulatorAfter - accumulatorBefore;
+        if ((delta > CHECKPOINT_DELTA) && (delta <= INT32_MAX))
+        {
+            entry.accumulatorDelta = (int32_t)delta;
+        }
+        else
+        {
+            entry.accumulatorDelta = CHECKPOINT_DELTA;
+            m_checkpoints.push_back(accumulatorAfter);
+        }
+        m_entries.Write(entry);
+    }
+
+    // calls func(instructionIndex, accumulatorDelta) for each entry, oldest first
+    template<typename Func>
+    void ForEach(Func func) const
+    {
+        BigInt accumulator = m_accumulatorBeforeOldest;
+        auto checkpointIter = m_checkpoints.cbegin();
+        for (const ProgramTraceEntry& entry: m_entries)
+        {
+            const BigInt accumulatorAfter =
+                (entry.accumulatorDelta == CHECKPOINT_DELTA) ? *checkpointIter++ : (accumulator + entry.accumulatorDelta);
+            func((BigInt)entry.instructionIndex, accumulatorAfter - accumulator);
+            accumulator = accumulatorAfter;
+        }
+    }
+
+private:
+    void PopOldest()
+    {
+        const ProgramTraceEntry entry = m_entries.Read();
+        if (entry.accumulatorDelta == CHECKPOINT_DELTA)
+        {
+            m_accumulatorBeforeOldest = m_checkpoints.front();
+            m_checkpoints.pop_front();
+        }
+        else
+        {
+            m_accumulatorBeforeOldest += entry.accumulatorDelta;
+        }
+    }
+
+    CircularBuffer<ProgramTraceEntry, 16> m_entries;
+    BigIntDeque m_checkpoints;
+    BigInt m_accumulatorBeforeOldest;
+};
+
+struct ProgramFix
+{
+    BigInt instructionIndex;
+    InstructionType origInstructionType;
+    BigInt accumulatorAfterTermination;
+};
+
+typedef std::vector<ProgramFix> ProgramFixList;
+
+// Fast interpreter for Program:  instructions are lowered to CompiledInstruction, with a HALT instruction at the end
+// so that termination is just another opcode, and a visited bit per instruction is checked as part of dispatch.
+class CompiledProgram
+{
+public:
+    CompiledProgram(const std::vector<Instruction>& instructions) : m_hasConditionalJumps(false), m_usesMemory(false)
+    {
+        const BigInt numInstructions = (BigInt)instructions.size();
+        m_code.resize(numInstructions + 1);
+        for (BigInt i = 0; i < numInstructions; ++i)
+        {
+            const Instruction& instruction = instructions[i];
+            m_code[i] = CompileInstruction(i, instruction.type, instruction.reg, instruction.arg);
+            const InstructionInfo& info = GetInstructionInfo(instruction.type);
+            if (IsConditionalJump(info.control))
+                m_hasConditionalJumps = true;
+            if (info.operands == InstructionOperands::ADDRESS)
+                m_usesMemory = true;
+        }
+        m_code[numInstructions] = MakeInstruction(CompiledOpcode::HALT, 0, 0);
+    }
+
+    BigInt GetNumInstructions() const { return (BigInt)m_code.size() - 1; }
+
+    // runs until termination or until an instruction is about to run a second time
+    void Run(ProgramRunResult& result, ProgramTrace* pTrace = nullptr) const
+    {
+        BitWordList visited(CalcNumVisitedWords(), 0);
+        if (pTrace)
+            Execute<false, true, true>(visited.data(), -1, CompiledInstruction(), MAX_BIG_INT, pTrace, result);
+        else
+            Execute<false, false, true>(visited.data(), -1, CompiledInstruction(), MAX_BIG_INT, nullptr, result);
+    }
+
+    // runs as if the given instruction were of a different type, without modifying the program
+    void RunWithPatch(BigInt patchIndex, InstructionType patchType, ProgramRunResult& result) const
+    {
+        assert((patchIndex >= 0) && (patchIndex < GetNumInstructions()));
+
+        const CompiledInstruction& origInstruction = m_code[patchIndex];
+        const CompiledInstruction patch = CompileInstruction(patchIndex, patchType, origInstruction.reg, origInstruction.arg);
+        BitWordList visited(CalcNumVisitedWords(), 0);
+        Execute<true, false, true>(visited.data(), patchIndex, patch, MAX_BIG_INT, nullptr, result);
+    }
+
+    // runs without loop detection (the extended instruction set can legitimately revisit instructions), until
+    // termination or until maxInstructions have been executed
+    void RunFor(BigInt maxInstructions, ProgramRunResult& result, ProgramTrace* pTrace = nullptr) const
+    {
+        if (pTrace)
+            Execute<false, true, false>(nullptr, -1, CompiledInstruction(), maxInstructions, pTrace, result);
+        else
+            Execute<false, false, false>(nullptr, -1, CompiledInstruction(), maxInstructions, nullptr, result);
+    }
+
+    // Same as Program::FindFix, in linear time:  marks every instruction from which the end of the program is
+    // reachable (by walking the reversed control flow back from the end), then walks the original path once, looking
+    // for the NOP or JMP whose flipped successor is marked.  Conditional jumps aren't supported.
+    bool FindFix(BigInt& instructionToFix, InstructionType& origInstructionType, BigInt& accumulatorAfterTermination) const
+    {
+        instructionToFix = -1;
+        origInstructionType = InstructionType::NOP;
+        accumulatorAfterTermination = -1;
+
+        if (m_hasConditionalJumps)
+            return false;
+
+        const BigInt numInstructions = GetNumInstructions();
+        const BigInt numNodes = numInstructions + 1;
+
+        // predecessors of instruction i are in [predecessorOffsets[i], predecessorOffsets[i + 1])
+        BigIntList predecessorOffsets(numNodes + 1, 0);
+        for (BigInt i = 0; i < numInstructions; ++i)
+        {
+            const BigInt next = CalcNextIndex(i, m_code[i]);
+            if (next >= 0)
+                ++predecessorOffsets[next + 1];
+        }
+        for (BigInt i = 0; i < numNodes; ++i)
+            predecessorOffsets[i + 1] += predecessorOffsets[i];
+
+        BigIntList predecessors(predecessorOffsets[numNodes]);
+        BigIntList fillIndices(predecessorOffsets.cbegin(), predecessorOffsets.cend() - 1);
+        for (BigInt i = 0; i < numInstructions; ++i)
+        {
+            const BigInt next = CalcNextIndex(i, m_code[i]);
+            if (next >= 0)
+                predecessors[fillIndices[next]++] = i;
+        }
+
+        BoolList reachesEnd(numNodes, false);
+        BigIntList toVisit;
+        toVisit.push_back(numInstructions);
+        reachesEnd[numInstructions] = true;
+        while (!toVisit.empty())
+        {
+            const BigInt index = toVisit.back();
+            toVisit.pop_back();
+            for (BigInt i = predecessorOffsets[index]; i < predecessorOffsets[index + 1]; ++i)
+            {
+                if (!reachesEnd[predecessors[i]])
+                {
+                    reachesEnd[predecessors[i]] = true;
+                    toVisit.push_back(predecessors[i]);
+                }
+            }
+        }
+
+        // nothing to fix if the program already terminates
+        if (reachesEnd[0])
+            return false;
+
+        // only instructions on the original path can change anything;  like Program::FindFix, prefer the lowest index
+        BoolList visited(numNodes, false);
+        for (BigInt index = 0; (index >= 0) && !visited[index]; index = CalcNextIndex(index, m_code[index]))
+        {
+            visited[index] = true;
+
+            const CompiledInstruction& instruction = m_code[index];
+            if (!IsFlippable(instruction))
+                continue;
+
+            const InstructionType flippedType = FlipInstructionType(instruction);
+            const BigInt flippedNext = CalcNextIndex(index, CompileInstruction(index, flippedType, 0, instruction.arg));
+            if ((flippedNext >= 0) && reachesEnd[flippedNext] && ((instructionToFix < 0) || (index < instructionToFix)))
+                instructionToFix = index;
+        }
+
+        if (instructionToFix < 0)
+            return false;
+
+        const InstructionType fixedType = FlipInstructionType(m_code[instructionToFix]);
+        origInstructionType = (fixedType == InstructionType::NOP) ? InstructionType::JMP : InstructionType::NOP;
+
+        ProgramRunResult result;
+        RunWithPatch(instructionToFix, fixedType, result);
+        assert(result.outcome == ProgramOutcome::TERMINATED);
+        accumulatorAfterTermination = result.accumulator;
+        return true;
+    }
+
+    // Tries every NOP/JMP flip on worker threads, each running over the shared program with its own patch, and
+    // returns the lowest-index fixes that make the program terminate, sorted by index.  With maxFixes > 0, workers
+    // stop picking up new candidates once that many have been found.  Like FindFix, conditional jumps aren't supported
+    // (loops are detected by revisiting an instruction, which a conditional loop does legitimately), so programs with
+    // them get no fixes.
+    void FindFixesInParallel(BigInt maxFixes, ProgramFixList& fixes, BigInt numThreads = 0) const
+    {
+        fixes.clear();
+
+        if (m_hasConditionalJumps)
+            return;
+
+        BigIntList candidates;
+        for (BigInt i = 0; i < GetNumInstructions(); ++i)
+        {
+            if (IsFlippable(m_code[i]))
+                candidates.push_back(i);
+        }
+        if (candidates.empty())
+            return;
+
+        if (numThreads <= 0)
+            numThreads = std::max<BigInt>(1, std::thread::hardware_concurrency());
+        numThreads = std::min(numThreads, (BigInt)candidates.size());
+
+        std::atomic<BigInt> nextCandidate(0);
+        std::atomic<BigInt> numFound(0);
+        std::mutex fixesMutex;
+        auto tryCandidates = [&]() {
+            for (;;)
+            {
+                // candidates are claimed in order, so once enough fixes are found, everything unclaimed is a worse fix
+                if ((maxFixes > 0) && (numFound >= maxFixes))
+                    break;
+                const BigInt candidate = nextCandidate++;
+                if (candidate >= (BigInt)candidates.size())
+                    break;
+
+                const BigInt index = candidates[candidate];
+                const InstructionType flippedType = FlipInstructionType(m_code[index]);
+
+                ProgramRunResult result;
+                RunWithPatch(index, flippedType, result);
+                if (result.outcome != ProgramOutcome::TERMINATED)
+                    continue;
+
+                ProgramFix fix;
+                fix.instructionIndex = index;
+                fix.origInstructionType = (flippedType == InstructionType::NOP) ? InstructionType::JMP : InstructionType::NOP;
+                fix.accumulatorAfterTermination = result.accumulator;
+                {
+                    std::lock_guard<std::mutex> lock(fixesMutex);
+                    fixes.push_back(fix);
+                }
+                ++numFound;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (BigInt threadIndex = 1; threadIndex < numThreads; ++threadIndex)
+            threads.emplace_back(tryCandidates);
+        tryCandidates();
+        for (std::thread& thread: threads)
+            thread.join();
+
+        std::sort(fixes.begin(), fixes.end(), [](const ProgramFix& lhs, const ProgramFix& rhs) {
+            return lhs.instructionIndex < rhs.instructionIndex;
+        });
+        if ((maxFixes > 0) && ((BigInt)fixes.size() > maxFixes))
+            fixes.resize(maxFixes);
+    }
+
+private:
+    BigInt CalcNumVisitedWords() const { return ((BigInt)m_code.size() + NUM_BITS_PER_WORD - 1) / NUM_BITS_PER_WORD; }
+
+    // Opcodes are numbered like InstructionType.  Jump targets and memory addresses that are known to be bad become
+    // BAD_JUMP/BAD_ACCESS here, so the handlers don't check them;  conditional jump targets are checked when taken.
+    CompiledInstruction CompileInstruction(BigInt index, InstructionType type, BigInt reg, BigInt arg) const
+    {
+        assert((arg >= INT32_MIN) && (arg <= INT32_MAX));
+        assert((reg >= 0) && (reg < NUM_PROGRAM_REGISTERS));
+        const InstructionInfo& info = GetInstructionInfo(type);
+        if (info.control == InstructionControl::JUMP)
+        {
+            const BigInt target = index + arg;
+            if ((target < 0) || (target > GetNumInstructions()))
+                return MakeInstruction(CompiledOpcode::BAD_JUMP, reg, arg);
+        }
+        if ((info.operands == InstructionOperands::ADDRESS) && ((arg < 0) || (arg >= NUM_PROGRAM_MEMORY_WORDS)))
+            return MakeInstruction(CompiledOpcode::BAD_ACCESS, reg, arg);
+        return MakeInstruction((CompiledOpcode)type, reg, arg);
+    }
+
+    static CompiledInstruction MakeInstruction(CompiledOpcode opcode, BigInt reg, BigInt arg)
+    {
+        CompiledInstruction instruction = {};
+        instruction.arg = (int32_t)arg;
+        instruction.opcode = opcode;
+        instruction.reg = (uint8_t)reg;
+        return instruction;
+    }
+
+    static bool IsFlippable(const CompiledInstruction& instruction)
+    {
+        return (instruction.opcode == CompiledOpcode::NOP) || (instruction.opcode == CompiledOpcode::JMP)
+               || (instruction.opcode == CompiledOpcode::BAD_JUMP);
+    }
+
+    // NOP <-> JMP
+    static InstructionType FlipInstructionType(const CompiledInstruction& instruction)
+    {
+        assert(IsFlippable(instruction));
+        return (instruction.opcode == CompiledOpcode::NOP) ? InstructionType::JMP : InstructionType::NOP;
+    }
+
+    // -1 if execution stops at this instruction;  not meaningful for conditional jumps
+    static BigInt CalcNextIndex(BigInt index, const CompiledInstruction& instruction)
+    {
+        switch (instruction.opcode)
+        {
+            case CompiledOpcode::HALT:
+            case CompiledOpcode::BAD_JUMP:
+            case CompiledOpcode::BAD_ACCESS:
+                return -1;
+            default:
+                break;
+        }
+
+        switch (GetInstructionInfo((InstructionType)instruction.opcode).control)
+        {
+            case InstructionControl::NEXT:
+            default:
+                return index + 1;
+            case InstructionControl::JUMP:
+                return index + instruction.arg;
+            case InstructionControl::JUMP_IF_ZERO:
+            case InstructionControl::JUMP_IF_NONZERO:
+                return -1;
+        }
+    }
+
+    // With PATCHED, the instruction at patchIndex is replaced by patch.  With TRACED, every executed instruction is
+    // recorded to pTrace.  With DETECT_LOOPS, execution stops when an instruction is about to run a second time,
+    // otherwise after maxInstructions.
+    template<bool PATCHED, bool TRACED, bool DETECT_LOOPS>
+    void Execute(
+        BigUInt* pVisited,
+        BigInt patchIndex,
+        const CompiledInstruction& patch,
+        BigInt maxInstructions,
+        ProgramTrace* pTrace,
+        ProgramRunResult& result) const
+    {
+        const CompiledInstruction* pCode = m_code.data();
+        const BigUInt numInstructions = (BigUInt)GetNumInstructions();
+
+        BigInt index = 0;
+        BigInt nextIndex = 0;
+        BigInt accumulator = 0;
+        BigInt accumulatorBefore = 0;
+        BigInt numExecuted = 0;
+        // registers[0] is unused, the accumulator lives in its own variable so the base instructions stay fast
+        BigInt registers[NUM_PROGRAM_REGISTERS] = {};
+        // only programs with memory instructions pay for zeroing memory
+        BigIntList memory;
+        if (m_usesMemory)
+            memory.assign(NUM_PROGRAM_MEMORY_WORDS, 0);
+        BigInt* pMemory = memory.data();
+        ProgramOutcome outcome = ProgramOutcome::TERMINATED;
+        const CompiledInstruction* pInstruction = nullptr;
+
+#if defined(__GNUC__)
+        // threaded dispatch:  every handler jumps straight to the next one through the table
+        static const void* s_dispatchTable[] = {
+#define PROGRAM_DISPATCH_TABLE_ENTRY(NAME, mnemonic, operands, control, body) &&do##NAME,
+            PROGRAM_INSTRUCTION_SET(PROGRAM_DISPATCH_TABLE_ENTRY)
+#undef PROGRAM_DISPATCH_TABLE_ENTRY
+            &&doHalt,
+            &&doBadJump,
+            &&doBadAccess
+        };
+#define PROGRAM_JUMP_TO_HANDLER(opcode) goto* s_dispatchTable[(uint8_t)(opcode)]
+#else
+        // the handlers are expanded from the instruction set, so they share one switch rather than each expanding it
+#define PROGRAM_JUMP_TO_HANDLER(opcode) goto dispatchSwitch
+#endif
+
+#define PROGRAM_DISPATCH()                                                                                              \
+    {                                                                                                                   \
+        if (DETECT_LOOPS)                                                                                               \
+        {                                                                                                               \
+            BigUInt& visitedWord = pVisited[index / NUM_BITS_PER_WORD];                                                 \
+            const BigUInt visitedBit = 1ULL << (index % NUM_BITS_PER_WORD);                                             \
+            if (visitedWord & visitedBit)                                                                               \
+                goto looped;                                                                                            \
+            visitedWord |= visitedBit;                                                                                  \
+        }                                                                                                               \
+        else if (numExecuted >= maxInstructions)                                                                        \
+        {                                                                                                               \
+            goto outOfBudget;                                                                                           \
+        }                                                                                                               \
+        pInstruction = (PATCHED && (index == patchIndex)) ? &patch : &pCode[index];                                     \
+        PROGRAM_JUMP_TO_HANDLER(pInstruction->opcode);                                                                  \
+    }
+
+#define PROGRAM_TRACE()                                                                                                 \
+    do                                                                                                                  \
+    {                                                                                                                   \
+        if (TRACED)                                                                                                     \
+            pTrace->Record(index, accumulatorBefore, accumulator);                                                      \
+    } while (0)
+
+        // unconditional jump targets were checked when compiled, conditional ones are checked here
+#define PROGRAM_NEXT_INDEX_NEXT() nextIndex = index + 1
+#define PROGRAM_NEXT_INDEX_JUMP() nextIndex = index + pInstruction->arg
+#define PROGRAM_NEXT_INDEX_CONDITIONAL(jumpTaken)                                                                       \
+    do                                                                                                                  \
+    {                                                                                                                   \
+        nextIndex = (jumpTaken) ? (index + pInstruction->arg) : (index + 1);                                            \
+        if ((BigUInt)nextIndex > numInstructions)                                                                       \
+            goto doBadJump;                                                                                             \
+    } while (0)
+#define PROGRAM_NEXT_INDEX_JUMP_IF_ZERO() PROGRAM_NEXT_INDEX_CONDITIONAL(PROGRAM_GET_REGISTER == 0)
+#define PROGRAM_NEXT_INDEX_JUMP_IF_NONZERO() PROGRAM_NEXT_INDEX_CONDITIONAL(PROGRAM_GET_REGISTER != 0)
+
+#define PROGRAM_ACCUMULATOR accumulator
+#define PROGRAM_ARG pInstruction->arg
+#define PROGRAM_REGISTER ((pInstruction->reg == 0) ? accumulator : registers[pInstruction->reg])
+#define PROGRAM_GET_REGISTER PROGRAM_REGISTER
+#define PROGRAM_SET_REGISTER(value) PROGRAM_REGISTER = (value)
+#define PROGRAM_MEMORY pMemory[pInstruction->arg]
+
+#define PROGRAM_HANDLER(NAME, mnemonic, operands, control, body)                                                        \
+    do##NAME:                                                                                                           \
+        PROGRAM_NEXT_INDEX_##control();                                                                                 \
+        accumulatorBefore = accumulator;                                                                                \
+        body;                                                                                                           \
+        ++numExecuted;                                                                                                  \
+        PROGRAM_TRACE();                                                                                                \
+        index = nextIndex;                                                                                              \
+        PROGRAM_DISPATCH();
+
+        PROGRAM_DISPATCH();
+
+#if !defined(__GNUC__)
+    dispatchSwitch:
+        switch (pInstruction->opcode)
+        {
+#define PROGRAM_SWITCH_CASE(NAME, mnemonic, operands, control, body)                                                    \
+    case CompiledOpcode::NAME:                                                                                          \
+        goto do##NAME;
+            PROGRAM_INSTRUCTION_SET(PROGRAM_SWITCH_CASE)
+#undef PROGRAM_SWITCH_CASE
+            case CompiledOpcode::HALT:
+                goto doHalt;
+            case CompiledOpcode::BAD_JUMP:
+                goto doBadJump;
+            case CompiledOpcode::BAD_ACCESS:
+            default:
+                goto doBadAccess;
+        }
+#endif
+
+        PROGRAM_INSTRUCTION_SET(PROGRAM_HANDLER)
+
+    doHalt:
+        outcome = ProgramOutcome::TERMINATED;
+        goto done;
+    doBadJump:
+        outcome = ProgramOutcome::BAD_JUMP;
+        goto done;
+    doBadAccess:
+        outcome = ProgramOutcome::BAD_ACCESS;
+        goto done;
+    looped:
+        outcome = ProgramOutcome::LOOPED;
+        goto done;
+    outOfBudget:
+        outcome = ProgramOutcome::OUT_OF_BUDGET;
+    done:
+
+#undef PROGRAM_HANDLER
+#undef PROGRAM_MEMORY
+#undef PROGRAM_SET_REGISTER
+#undef PROGRAM_GET_REGISTER
+#undef PROGRAM_REGISTER
+#undef PROGRAM_ARG
+#undef PROGRAM_ACCUMULATOR
+#undef PROGRAM_NEXT_INDEX_JUMP_IF_NONZERO
+#undef PROGRAM_NEXT_INDEX_JUMP_IF_ZERO
+#undef PROGRAM_NEXT_INDEX_CONDITIONAL
+#undef PROGRAM_NEXT_INDEX_JUMP
+#undef PROGRAM_NEXT_INDEX_NEXT
+#undef PROGRAM_TRACE
+#undef PROGRAM_DISPATCH
+#undef PROGRAM_JUMP_TO_HANDLER
+
+        result.outcome = outcome;
+        result.accumulator = accumulator;
+        result.lastInstructionIndex = index;
+        result.numInstructionsExecuted = numExecuted;
+    }
+
+    std::vector<CompiledInstruction> m_code;
+    bool m_hasConditionalJumps;
+    bool m_usesMemory;   // only LDM/STM touch memory
+};
+
+void PrintProgramRunResult(const char* name, const ProgramRunResult& result)
+{
+    static const char* s_outcomeNames[] = {
+        "terminated", "looped", "made a bad jump", "made a bad memory access", "ran out of instruction budget"
+    };
+    printf(
+        "%s %s at instruction %lld after executing %lld instructions, accumulator = %lld\n",
+        name,
+        s_outcomeNames[(BigInt)result.outcome],
+        result.lastInstructionIndex,
+        result.numInstructionsExecuted,
+        result.accumulator);
+}
+
+void RunHandheldHalting()
+{
+    Program testProgram("Day8TestInput.txt");
+    printf("Test program, running until loop:\n");
+    testProgram.ExecuteUntilLoopsOrTerminates(true);
+    printf("Accumulator = %lld\n", testProgram.GetAccumulator());
+    printf("Fixing test program\n");
+    BigInt instructionToFix;
+    InstructionType origInstructionType;
+    BigInt accumulatorAfterFix;
+    testProgram.FindFix(instructionToFix, origInstructionType, accumulatorAfterFix, true);
+    printf(
+        "Test program was fixed by changing instruction %lld from %s to %s, allowing program to terminate normally with accumulator = %lld\n",
+        instructionToFix,
+        (origInstructionType == InstructionType::NOP) ? "NOP" : "JMP",
+        (origInstructionType == InstructionType::NOP) ? "JMP" : "NOP",
+        accumulatorAfterFix);
+
+    Program program("Day8Input.txt");
+    printf("\nMain program, running until loop:\n");
+    program.ExecuteUntilLoopsOrTerminates(false);
+    printf("Accumulator = %lld\n", program.GetAccumulator());
+    printf("Fixing main program\n");
+    program.FindFix(instructionToFix, origInstructionType, accumulatorAfterFix, true);
+    printf(
+        "Main program was fixed by changing instruction %lld from %s to %s, allowing program to terminate normally with accumulator = %lld\n",
+        instructionToFix,
+        (origInstructionType == InstructionType::NOP) ? "NOP" : "JMP",
+        (origInstructionType == InstructionType::NOP) ? "JMP" : "NOP",
+        accumulatorAfterFix);
+
+    ProgramRunResult runResult;
+    CompiledProgram(testProgram.GetInstructions()).Run(runResult);
+    PrintProgramRunResult("\nCompiled test program", runResult);
+    const CompiledProgram compiledProgram(program.GetInstructions());
+    compiledProgram.Run(runResult);
+    PrintProgramRunResult("Compiled main program", runResult);
+
+    if (compiledProgram.FindFix(instructionToFix, origInstructionType, accumulatorAfterFix))
+        printf(
+            "Linear fix finder changed instruction %lld from %s to %s, allowing program to terminate normally with accumulator = %lld\n",
+            instructionToFix,
+            (origInstructionType == InstructionType::NOP) ? "NOP" : "JMP",
+            (origInstructionType == InstructionType::NOP) ? "JMP" : "NOP",
+            accumulatorAfterFix);
+
+    ProgramFixList fixes;
+    compiledProgram.FindFixesInParallel(0, fixes);
+    printf("Parallel fix search found %lld fixes:  ", (BigInt)fixes.size());
+    for (const ProgramFix& fix: fixes)
+        printf("%lld (accumulator = %lld)  ", fix.instructionIndex, fix.accumulatorAfterTermination);
+    printf("\n");
+
+    Program extendedProgram("Day8TestInputB.txt");
+    printf("\nExtended test program, running until it terminates:\n");
+    extendedProgram.ExecuteUntilTerminates(1000, true);
+    printf("Accumulator = %lld\n", extendedProgram.GetAccumulator());
+
+    std::unique_ptr<ProgramTrace> pTrace(new ProgramTrace());
+    CompiledProgram(extendedProgram.GetInstructions()).RunFor(1000, runResult, pTrace.get());
+    PrintProgramRunResult("Compiled extended test program", runResult);
+
+    BigIntList traceCounts(extendedProgram.GetInstructions().size(), 0);
+    BigInt tracedAccumulator = 0;
+    pTrace->ForEach([&](BigInt instructionIndex, BigInt accumulatorDelta) {
+        ++traceCounts[instructionIndex];
+        tracedAccumulator += accumulatorDelta;
+    });
+    const BigInt hottestIndex = std::max_element(traceCounts.cbegin(), traceCounts.cend()) - traceCounts.cbegin();
+    printf(
+        "Trace has %lld entries, accumulator from trace = %lld, hottest instruction is %lld, run %lld times\n",
+        pTrace->GetSize(),
+        tracedAccumulator,
+        hottestIndex,
+        traceCounts[hottestIndex]);
+}
+
+
+////////////////////////////
+// Problem 9 - Encoding Error
+
+// The last windowSize numbers of an XMAS series, with a count per value so that duplicates are kept and pair lookups
+// are a hash probe:  FindPair is O(windowSize), Push is O(1).
+class XMasWindow
+{
+public:
+    XMasWindow(BigInt windowSize) : m_values(windowSize), m_numValues(0), m_nextIndex(0)
+    {
+        assert(windowSize > 0);
+        m_counts.reserve(windowSize * 2);
+    }
+
+    BigInt GetWindowSize() const { return (BigInt)m_values.size(); }
+    bool IsFull() const { return m_numValues == GetWindowSize(); }
+
+    void Clear()
+    {
+        m_counts.clear();
+        m_numValues = m_nextIndex = 0;
+    }
+
+    // adds a number, dropping the oldest one if the window is full
+    void Push(BigInt number)
+    {
+        if (IsFull())
+        {
+            auto iter = m_counts.find(m_values[m_nextIndex]);
+            assert(iter != m_counts.end());
+            if (--iter->second == 0)
+                m_counts.erase(iter);
+        }
+        else
+        {
+            ++m_numValues;
+        }
+
+        m_values[m_nextIndex] = number;
+        ++m_counts[number];
+        if (++m_nextIndex == GetWindowSize())
+            m_nextIndex = 0;
+    }
+
+    // true if two different entries of the window (which may hold the same value) sum to target
+    bool FindPair(BigInt target, BigInt& firstNumber, BigInt& secondNumber) const
+    {
+        for (BigInt i = 0; i < m_numValues; ++i)
+        {
+            const BigInt number = m_values[i];
+            const BigInt otherNumber = target - number;
+            auto iter = m_counts.find(otherNumber);
+            if ((iter != m_counts.cend()) && ((otherNumber != number) || (iter->second >= 2)))
+            {
+                firstNumber = std::min(number, otherNumber);
+                secondNumber = std::max(number, otherNumber);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    BigIntList m_values;
+    std::unordered_map<BigInt, BigInt> m_counts;
+    BigInt m_numValues;
+    BigInt m_nextIndex;
+};
+
+// Validates an unbounded XMAS feed one number at a time, keeping only the window:  the first windowSize numbers are
+// the preamble, and every later number must be the sum of two of the windowSize numbers before it.  Invalid numbers
+// still enter the window, since they're part of the series the following numbers are checked against.
+class XMasStreamValidator
+{
+public:
+    XMasStreamValidator(BigInt windowSize) : m_window(windowSize), m_numConsumed(0), m_numInvalid(0) {}
+
+    BigInt GetNumConsumed() const { return m_numConsumed; }
+    BigInt GetNumInvalid() const { return m_numInvalid; }
+
+    // returns false if the number is invalid
+    bool Consume(BigInt number)
+    {
+        BigInt firstNumber = 0;
+        BigInt secondNumber = 0;
+        const bool isValid = !m_window.IsFull() || m_window.FindPair(number, firstNumber, secondNumber);
+        if (!isValid)
+            ++m_numInvalid;
+
+        m_window.Push(number);
+        ++m_numConsumed;
+        return isValid;
+    }
+
+    // Consumes whitespace-separated numbers until the end of the stream, calling onInvalid(index, number) for each
+    // invalid one as soon as it's read.  Returns the number of invalid numbers found in this stream.
+    template<typename OnInvalidFunc>
+    BigInt ConsumeStream(FILE* pFile, OnInvalidFunc onInvalid)
+    {
+        const BigInt prevNumInvalid = m_numInvalid;
+        long long number = 0;
+        while (fscanf(pFile, "%lld", &number) == 1)
+        {
+            const BigInt index = m_numConsumed;
+            if (!Consume(number))
+                onInvalid(index, (BigInt)number);
+        }
+        return m_numInvalid - prevNumInvalid;
+    }
+
+private:
+    XMasWindow m_window;
+    BigInt m_numConsumed;
+    BigInt m_numInvalid;
+};
+
+class XMasNumberSeries
+{
+public:
+    XMasNumberSeries(BigInt windowSize, const char* fileName) : m_windowSize(windowSize)
+    {
+        StringList lines;
+        ReadFileLines(fileName, lines);
+        for (BigInt i = 0; i < (BigInt)lines.size(); ++i)
+        {
+            m_numbers.push_back(atoll(lines[i].c_str()));
+        }
+    }
+    XMasNumberSeries(BigInt windowSize, const BigIntList& numbers) : m_windowSize(windowSize), m_numbers(numbers) {}
+
+    BigInt FindFirstInvalidNumber(bool verbose) const
+    {
+        XMasWindow window(m_windowSize);
+        for (BigInt i = 0; (i < m_windowSize) && (i < (BigInt)m_numbers.size()); ++i)
+            window.Push(m_numbers[i]);
+
+        for (BigInt i = m_windowSize; i < (BigInt)m_numbers.size(); ++i)
+        {
+            const BigInt thisNumber = m_numbers[i];
+
+            BigInt firstNumber = 0;
+            BigInt secondNumber = 0;
+            if (!window.FindPair(thisNumber, firstNumber, secondNumber))
+                return thisNumber;
+
+            if (verbose)
+                printf("This number %lld is the sum of %lld and %lld, therefore valid\n", thisNumber, firstNumber, secondNumber);
+
+            window.Push(thisNumber);
+        }
+
+        return -1;
+    }
+
+    // Same result as FindFirstInvalidNumber, with the series split into chunks that worker threads claim in order.
+    // Each chunk seeds its own window from the windowSize numbers before it, and workers skip anything past the
+    // earliest invalid index found so far.
+    BigInt FindFirstInvalidNumberInParallel(BigInt numThreads = 0, BigInt chunkSize = 0) const
+    {
+        const BigInt numNumbers = (BigInt)m_numbers.size();
+        if (numNumbers <= m_windowSize)
+            return -1;
+
+        if (numThreads <= 0)
+            numThreads = std::max<BigInt>(1, std::thread::hardware_concurrency());
+        // chunks much larger than the window, so seeding stays a small fraction of the work
+        if (chunkSize <= 0)
+            chunkSize = std::max((numNumbers - m_windowSize) / (numThreads * 4), m_windowSize * 16);
+        const BigInt numChunks = (numNumbers - m_windowSize + chunkSize - 1) / chunkSize;
+        numThreads = std::min(numThreads, numChunks);
+
+        std::atomic<BigInt> nextChunk(0);
+        std::atomic<BigInt> firstInvalidIndex(numNumbers);
+        auto validateChunks = [&]() {
+            XMasWindow window(m_windowSize);
+            for (;;)
+            {
+                const BigInt chunk = nextChunk++;
+                const BigInt chunkBegin = m_windowSize + chunk * chunkSize;
+                // chunks are claimed in order, so every later chunk starts past the invalid number too
+                if ((chunk >= numChunks) || (chunkBegin >= firstInvalidIndex))
+                    break;
+                const BigInt chunkEnd = std::min(chunkBegin + chunkSize, numNumbers);
+
+                window.Clear();
+                for (BigInt i = chunkBegin - m_windowSize; i < chunkBegin; ++i)
+                    window.Push(m_numbers[i]);
+
+                for (BigInt i = chunkBegin; i < chunkEnd; ++i)
+                {
+                    BigInt firstNumber = 0;
+                    BigInt secondNumber = 0;
+                    if (!window.FindPair(m_numbers[i], firstNumber, secondNumber))
+                    {
+                        BigInt prevIndex = firstInvalidIndex;
+                        while ((i < prevIndex) && !firstInvalidIndex.compare_exchange_weak(prevIndex, i)) {}
+                        break;
+                    }
+                    window.Push(m_numbers[i]);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (BigInt threadIndex = 1; threadIndex < numThreads; ++threadIndex)
+            threads.emplace_back(validateChunks);
+        validateChunks();
+        for (std::thread& thread: threads)
+            thread.join();
+
+        return (firstInvalidIndex < numNumbers) ? m_numbers[firstInvalidIndex] : -1;
+    }
+
+    BigInt FindEncryptionWeakness(BigInt invalidNumber, bool verbose) const
+    {
+        assert(invalidNumber == FindFirstInvalidNumber(false));
+
+        BigInt sum = 0;
+        // indices in [firstIndex, secondIndex] whose numbers are increasing (minIndices) or decreasing (maxIndices),
+        // so the smallest and largest numbers in the sum are always at the fronts
+        BigIntDeque minIndices;
+        BigIntDeque maxIndices;
+        auto pushIndex = [&](BigInt index) {
+            const BigInt number = m_numbers[index];
+            while (!minIndices.empty() && (m_numbers[minIndices.back()] >= number))
+                minIndices.pop_back();
+            minIndices.push_back(index);
+            while (!maxIndices.empty() && (m_numbers[maxIndices.back()] <= number))
+                maxIndices.pop_back();
+            maxIndices.push_back(index);
+        };
+        auto popIndicesBefore = [&](BigInt index) {
+            while (minIndices.front() < index)
+                minIndices.pop_front();
+            while (maxIndices.front() < index)
+                maxIndices.pop_front();
+        };
+
+        assert(m_numbers.size() >= 2);
+
+        BigInt firstIndex = 0;
+        BigInt secondIndex = 1;
+        const BigInt firstNumber = m_numbers[firstIndex];
+        const BigInt secondNumber = m_numbers[secondIndex];
+
+        sum = firstNumber + secondNumber;
+        if (sum == invalidNumber)
+        {
+            if (verbose)
+                printf(
+                    "Immediately found encryption weakness with first number = %lld, second number = %lld\n",
+                    firstNumber,
+                    secondNumber);
+            return sum;
+        }
+
+        pushIndex(firstIndex);
+        pushIndex(secondIndex);
+
+        if (verbose)
+            printf("Starting with first number = %lld, second number = %lld\n", firstNumber, secondNumber);
+
+        for (;;)
+        {
+            if (sum < invalidNumber)
+            {
+                if (secondIndex >= ((BigInt)m_numbers.size() - 1))
+                    return -1;
+
+                ++secondIndex;
+                const BigInt newNumber = m_numbers[secondIndex];
+                sum += newNumber;
+                pushIndex(secondIndex);
+
+                if (verbose)
+                {
+                    printf("Added new second number, sum = %lld, sequence is now:  ", sum);
+                    for (BigInt i = firstIndex; i <= secondIndex; ++i)
+                    {
+                        printf("%lld ", m_numbers[i]);
+                    }
+                    printf("\n");
+                }
+            }
+            else
+            {
+                assert(sum > invalidNumber);
+
+                const BigInt prevNumber = m_numbers[firstIndex];
+                sum -= prevNumber;
+                ++firstIndex;
+                popIndicesBefore(firstIndex);
+
+                if (firstIndex == secondIndex)
+                {
+                    if (secondIndex >= ((BigInt)m_numbers.size() - 1))
+                        return -1;
+
+                    ++secondIndex;
+                    const BigInt newNumber = m_numbers[secondIndex];
+                    sum += newNumber;
+                    pushIndex(secondIndex);
+
+                    if (verbose)
+                    {
+                        printf("Incremented first and second numbers, sum = %lld, sequence is now:  ", sum);
+                        for (BigInt i = firstIndex; i <= secondIndex; ++i)
+                        {
+                            printf("%lld ", m_numbers[i]);
+                        }
+                        printf("\n");
+                    }
+                }
+                else
+                {
+                    if (verbose)
+                    {
+                        printf("Removed first number, sum = %lld, sequence is now:  ", sum);
+                        for (BigInt i = firstIndex; i <= secondIndex; ++i)
+                        {
+                            printf("%lld ", m_numbers[i]);
+                        }
+                        printf("\n");
+                    }
+                }
+            }
+
+            if (sum == invalidNumber)
+            {
+                assert(secondIndex > firstIndex);
+                const BigInt smallest = m_numbers[minIndices.front()];
+                const BigInt largest = m_numbers[maxIndices.front()];
+                const BigInt weakness = smallest + largest;
+
+                if (verbose)
+                {
+                    printf(
+                        "Found valid sum = %lld, smallest is %lld, largest is %lld, weakness is %lld, sequence is:  ",
+                        sum,
+                        smallest,
+                        largest,
+                        weakness);
+                    for (BigInt i = firstIndex; i <= secondIndex; ++i)
+                    {
+                        printf("%lld ", m_numbers[i]);
+                    }
+                    printf("\n");
+                }
+
+                return weakness;
+            }
+        }
+
+        return -1;
+    }
+
+    // Same as FindEncryptionWeakness, but for series that may contain zero or negative numbers, where shrinking the
+    // range no longer reduces the sum:  a range [first, last] sums to invalidNumber exactly when
+    // prefixSum(last + 1) - prefixSum(first) == invalidNumber, so the earliest prefix sum of each value is kept in a
+    // hash map and looked up as the prefix sums are produced.  Finds the range with the lowest last index (and then
+    // the lowest first index) of at least two numbers, in O(n).
+    bool FindEncryptionWeaknessSigned(BigInt invalidNumber, BigInt& weakness, BigInt& firstIndex, BigInt& lastIndex) const
+    {
+        weakness = firstIndex = lastIndex = -1;
+
+        // prefix sum -> earliest index it was seen at;  prefix sum i is the sum of the first i numbers
+        std::unordered_map<BigInt, BigInt> prefixSumIndices;
+        prefixSumIndices.reserve(m_numbers.size());
+
+        BigInt prevPrefixSum = 0;
+        BigInt prefixSum = 0;
+        for (BigInt i = 0; i < (BigInt)m_numbers.size(); ++i)
+        {
+            // prefix sum i - 1 only becomes usable now, so that ranges have at least two numbers
+            if (i > 0)
+                prefixSumIndices.emplace(prevPrefixSum, i - 1);
+            prevPrefixSum = prefixSum;
+            prefixSum += m_numbers[i];
+
+            auto iter = prefixSumIndices.find(prefixSum - invalidNumber);
+            if (iter != prefixSumIndices.cend())
+            {
+                firstIndex = iter->second;
+                lastIndex = i;
+                break;
+            }
+        }
+
+        if (firstIndex < 0)
+            return false;
+
+        auto range = std::minmax_element(m_numbers.cbegin() + firstIndex, m_numbers.cbegin() + lastIndex + 1);
+        weakness = *range.first + *range.second;
+        return true;
+    }
+
+
+private:
+    BigInt m_windowSize;
+    BigIntList m_numbers;
+};
+
+void RunEncodingError()
+{
+    XMasNumberSeries testSeries(5, "Day9TestInput.txt");
+    BigInt firstInvalidNumber = testSeries.FindFirstInvalidNumber(true);
+    printf("First invalid number in test series = %lld\n", firstInvalidNumber);
+    printf("Encryption weakness = %lld\n", testSeries.FindEncryptionWeakness(firstInvalidNumber, true));
+
+    XMasNumberSeries mainSeries(25, "Day9Input.txt");
+    firstInvalidNumber = mainSeries.FindFirstInvalidNumber(true);
+    printf("First invalid number in main series = %lld\n", firstInvalidNumber);
+    printf(
+        "First invalid number from parallel search = %lld, with small chunks = %lld\n",
+        mainSeries.FindFirstInvalidNumberInParallel(),
+        mainSeries.FindFirstInvalidNumberInParallel(4, 50));
+    printf("Encryption weakness = %lld\n", mainSeries.FindEncryptionWeakness(firstInvalidNumber, false));
+
+    BigInt weakness = 0;
+    BigInt firstIndex = 0;
+    BigInt lastIndex = 0;
+    if (mainSeries.FindEncryptionWeaknessSigned(firstInvalidNumber, weakness, firstIndex, lastIndex))
+        printf("Encryption weakness from prefix sums = %lld, numbers %lld to %lld\n", weakness, firstIndex, lastIndex);
+
+    XMasNumberSeries signedSeries(2, BigIntList{ 7, -3, 4, 0, -5, 9, 2, -6, 8 });
+    if (signedSeries.FindEncryptionWeaknessSigned(6, weakness, firstIndex, lastIndex))
+        printf("Signed series sums to 6 from numbers %lld to %lld, weakness = %lld\n", firstIndex, lastIndex, weakness);
+
+    XMasNumberSeries duplicatesSeries(3, "Day9TestInputB.txt");
+    printf("First invalid number in series with duplicates = %lld\n", duplicatesSeries.FindFirstInvalidNumber(true));
+
+    std::string streamFileName = fileNameBase;
+    streamFileName += "Day9Input.txt";
+    FILE* pStreamFile = fopen(streamFileName.c_str(), "rt");
+    assert(pStreamFile);
+    printf("Streaming main series, invalid numbers:  ");
+    XMasStreamValidator validator(25);
+    validator.ConsumeStream(pStreamFile, [](BigInt index, BigInt number) { printf("%lld (at %lld)  ", number, index); });
+    printf("\n%lld of %lld streamed numbers are invalid\n", validator.GetNumInvalid(), validator.GetNumConsumed());
+    fclose(pStreamFile);
+}
+
+
+////////////////////////////
+// Problem 10 - Adapter Array
+
+void ReadAdapterArray(const char* fileName, std::set<BigInt>& jolts, bool verbose)
+{
+    StringList lines;
+    ReadFileLines(fileName, lines);
+
+    jolts.clear();
+    for (BigInt i = 0; i < (BigInt)lines.size(); ++i)
+    {
+        jolts.insert(atoi(lines[i].c_str()));
+    }
+
+    if (verbose)
+    {
+        printf("Read adapter array from '%s', sorted list = ", fileName);
+        for (auto iter = jolts.cbegin(); iter != jolts.cend(); ++iter)
+        {
+            printf("%lld ", *iter);
+        }
+        printf("\n");
+    }
+}
+
+void CalcAdaptorJoltGaps(
+    const std::set<BigInt>& jolts, BigInt& num1JoltGaps, BigInt& num2JoltGaps, BigInt& num3JoltGaps, bool verbose)
+{
+    assert(jolts.size() >= 2);
+    assert(*jolts.cbegin() <= 3);
+
+    num1JoltGaps = 0;
+    num2JoltGaps = 0;
+    num3JoltGaps = 0;
+
+    BigInt prevJolt = 0;
+    for (auto iter = jolts.cbegin(); iter != jolts.cend(); ++iter)
+    {
+        const BigInt thisJolt = *iter;
+        const BigInt joltGap = thisJolt - prevJolt;
+        assert(joltGap >= 1);
+        assert(joltGap <= 3);
+
+        if (joltGap == 1)
+            ++num1JoltGaps;
+        else if (joltGap == 3)
+            ++num3JoltGaps;
+
+        if (verbose)
+        {
+            printf("This jolt = %lld, which is a gap %lld from prev jolt %lld\n", thisJolt, joltGap, prevJolt);
+            if (joltGap == 1)
+                printf("Num 1-jolt gaps incremented to %lld\n", num1JoltGaps);
+            else if (joltGap == 2)
+                printf("Num 2-jolt gaps incremented to %lld\n", num2JoltGaps);
+            else if (joltGap == 3)
+                printf("Num 3-jolt gaps incremented to %lld\n", num3JoltGaps);
+        }
+
+        prevJolt = thisJolt;
+    }
+
+    ++num3JoltGaps;
+    if (verbose)
+        printf(
+            "Final 3-jolt gap from %lld to %lld\nFound %lld 1-jolt gaps, %lld 2-jolt gaps, and %lld 3-jolt gaps\n",
+            prevJolt,
+            prevJolt + 3,
+            num1JoltGaps,
+            num2JoltGaps,
+            num3JoltGaps);
+}
+
+BigInt CalcProdAdaptor1JoltAnd3JoltGaps(const std::set<BigInt>& jolts, bool verbose)
+{
+    BigInt num1JoltGaps = 0;
+    BigInt num2JoltGaps = 0;
+    BigInt num3JoltGaps = 0;
+    CalcAdaptorJoltGaps(jolts, num1JoltGaps, num2JoltGaps, num3JoltGaps, verbose);
+
+    return num1JoltGaps * num3JoltGaps;
+}
+
+void IncrementContigAdaptorStretches(BigIntMap& contigStretches, BigInt stretchLen, bool verbose)
+{
+    if (verbose)
+        printf("Finished a contig stretch of length %lld\n", stretchLen);
+
+    auto contigFinder = contigStretches.find(stretchLen);
+    if (contigFinder != contigStretches.end())
+    {
+        ++(contigFinder->second);
+        if (verbose)
+            printf("Now there are %lld contig stretches of length %lld\n", contigFinder->second, stretchLen);
+    }
+    else
+    {
+        contigStretches.insert(std::pair<BigInt, BigInt>(stretchLen, 1));
+        if (verbose)
+            printf("Now there is 1 contig stretch of length %lld\n", stretchLen);
+    }
+}
+
+void CalcContigAdaptorStretches(const std::set<BigInt>& jolts, BigIntMap& contigStretches, bool verbose)
+{
+    BigInt num1JoltGaps = 0;
+    BigInt num2JoltGaps = 0;
+    BigInt num3JoltGaps = 0;
+    CalcAdaptorJoltGaps(jolts, num1JoltGaps, num2JoltGaps, num3JoltGaps, false);
+
+    assert(num2JoltGaps == 0);
+
+    contigStretches.clear();
+    BigInt currStretchLen = 1;
+
+    BigInt prevJolt = 0;
+    for (auto iter = jolts.cbegin(); iter != jolts.cend(); ++iter)
+    {
+        const BigInt thisJolt = *iter;
+        const BigInt gap = thisJolt - prevJolt;
+
+        if (gap == 1)
+        {
+            ++currStretchLen;
+        }
+        else
+        {
+            assert(gap == 3);
+
+            IncrementContigAdaptorStretches(contigStretches, currStretchLen, verbose);
+
+            currStretchLen = 1;
+        }
+
+        prevJolt = thisJolt;
+    }
+    IncrementContigAdaptorStretches(contigStretches, currStretchLen, verbose);
+
+    if (verbose)
+    {
+        printf("Entire list of stretches:  ");
+        for (auto iter = contigStretches.cbegin(); iter != contigStretches.cend(); ++iter)
+            printf("%lldn of %lld  ", iter->second, iter->first);
+        printf("\n");
+    }
+}
+
+// Counts the ways to chain the outlet (0 jolts) to the device through sorted, distinct adapters, where each adapter and
+// the device accept an input 1 to maxReach jolts lower.  The device is rated maxReach above the highest adapter (so 3
+// above it for the puzzle's adapters), which keeps the highest adapter the only one that can feed it.  Each adapter's count
+// is the sum of the counts of the adapters within reach below it, so this is one pass of at most maxReach additions
+// per adapter.  With modulus > 0 the count is reduced modulo it, otherwise it's exact and this returns false if it
+// doesn't fit in a BigInt.
+bool CalcNumWaysToConnectAdaptors(const BigIntList& sortedJolts, BigInt maxReach, BigInt modulus, BigInt& numWays, bool verbose)
+{
+    assert(maxReach >= 1);
+    assert(modulus >= 0);
+
+    // ways[i + 1] is the count for sortedJolts[i], ways[0] for the outlet and ways[numAdapters + 1] for the device
+    const BigInt numAdapters = (BigInt)sortedJolts.size();
+    BigIntList ways(numAdapters + 2, 0);
+    ways[0] = (modulus == 1) ? 0 : 1;
+
+    auto joltOf = [&](BigInt wayIndex) -> BigInt {
+        if (wayIndex == 0)
+            return 0;
+        if (wayIndex > numAdapters)
+            return (numAdapters > 0) ? (sortedJolts.back() + maxReach) : maxReach;
+        return sortedJolts[wayIndex - 1];
+    };
+
+    for (BigInt i = 1; i <= numAdapters + 1; ++i)
+    {
+        const BigInt jolt = joltOf(i);
+        assert((i == 1) || (jolt > joltOf(i - 1)));
+
+        BigInt thisWays = 0;
+        for (BigInt j = i - 1; (j >= 0) && ((jolt - joltOf(j)) <= maxReach); --j)
+        {
+            if (modulus > 0)
+            {
+                thisWays = AddModulo(thisWays, ways[j], modulus);
+            }
+            else if (!CheckedAdd(thisWays, ways[j], thisWays))
+            {
+                if (verbose)
+                    printf("Number of ways overflows at %lld jolts\n", jolt);
+                return false;
+            }
+        }
+        ways[i] = thisWays;
+
+        if (verbose)
+            printf("%lld ways to reach %lld jolts\n", thisWays, jolt);
+    }
+
+    numWays = ways[numAdapters + 1];
+    return true;
+}
+
+bool CalcNumWaysToConnectAdaptors(const std::set<BigInt>& jolts, BigInt maxReach, BigInt modulus, BigInt& numWays, bool verbose)
+{
+    const BigIntList sortedJolts(jolts.cbegin(), jolts.cend());
+    return CalcNumWaysToConnectAdaptors(sortedJolts, maxReach, modulus, numWays, verbose);
+}
+
+// the exact count with a reach of 3, or -1 if it doesn't fit in a BigInt
+BigInt CalcNumWaysToConnectAdaptors(const std::set<BigInt>& jolts, bool verbose)
+{
+    // when every gap is 1 or 3 jolts, list the stretches of consecutive ratings before tracing the count
+    if (verbose)
+    {
+        BigInt num1JoltGaps = 0;
+        BigInt num2JoltGaps = 0;
+        BigInt num3JoltGaps = 0;
+        CalcAdaptorJoltGaps(jolts, num1JoltGaps, num2JoltGaps, num3JoltGaps, false);
+        if (num2JoltGaps == 0)
+        {
+            BigIntMap contigStretches;
+            CalcContigAdaptorStretches(jolts, contigStretches, true);
+        }
+    }
+
+    BigInt numWays = 0;
+    if (!CalcNumWaysToConnectAdaptors(jolts, 3, 0, numWays, verbose))
+        return -1;
+    return numWays;
+}
+
+// Adapter ratings are small distinct integers, so they can be stored as a presence bitmap, which sorts them as they're
+// read.  Bit 0 is always set, for the outlet.
+void ReadAdapterBitmap(const char* fileName, BitWordList& presence)
+{
+    StringList lines;
+    ReadFileLines(fileName, lines);
+
+    presence.assign(1, 1);
+    for (BigInt i = 0; i < (BigInt)lines.size(); ++i)
+    {
+        const BigInt jolt = atoll(lines[i].c_str());
+        assert(jolt > 0);
+        const BigInt wordIndex = jolt / NUM_BITS_PER_WORD;
+        if (wordIndex >= (BigInt)presence.size())
+            presence.resize(wordIndex + 1, 0);
+        presence[wordIndex] |= 1ULL << (jolt % NUM_BITS_PER_WORD);
+    }
+}
+
+void GetAdapterBitmapJolts(const BitWordList& presence, BigIntList& sortedJolts)
+{
+    sortedJolts.clear();
+    for (BigInt wordIndex = 0; wordIndex < (BigInt)presence.size(); ++wordIndex)
+    {
+        for (BigUInt word = presence[wordIndex]; word != 0; word &= word - 1)
+        {
+            const BigInt jolt = wordIndex * NUM_BITS_PER_WORD + FindLowestSetBit(word);
+            if (jolt > 0)
+                sortedJolts.push_back(jolt);
+        }
+    }
+}
+
+// gapHistogram[gap] is the number of gaps of that size between consecutive ratings, including the final 3-jolt gap to
+// the device
+void CalcAdapterBitmapGapHistogram(const BitWordList& presence, BigIntList& gapHistogram)
+{
+    gapHistogram.assign(4, 0);
+
+    BigInt prevJolt = 0;
+    for (BigInt wordIndex = 0; wordIndex < (BigInt)presence.size(); ++wordIndex)
+    {
+        for (BigUInt word = presence[wordIndex]; word != 0; word &= word - 1)
+        {
+            const BigInt jolt = wordIndex * NUM_BITS_PER_WORD + FindLowestSetBit(word);
+            const BigInt gap = jolt - prevJolt;
+            if (gap >= (BigInt)gapHistogram.size())
+                gapHistogram.resize(gap + 1, 0);
+            ++gapHistogram[gap];
+            prevJolt = jolt;
+        }
+    }
+    // the outlet isn't a gap
+    --gapHistogram[0];
+    ++gapHistogram[3];
+}
+
+// Same as CalcContigAdaptorStretches:  the stretches are runs of consecutive ratings (starting with the outlet), which
+// are found a word at a time by alternately skipping to the next set and the next clear bit.
+void CalcAdapterBitmapStretches(const BitWordList& presence, BigIntMap& contigStretches)
+{
+    contigStretches.clear();
+
+    const BigInt numBits = (BigInt)presence.size() * NUM_BITS_PER_WORD;
+    for (BigInt stretchBegin = FindNextSetBit(presence, 0); stretchBegin < numBits;)
+    {
+        const BigInt stretchEnd = FindNextClearBit(presence, stretchBegin);
+        ++contigStretches[stretchEnd - stretchBegin];
+        stretchBegin = FindNextSetBit(presence, stretchEnd);
+    }
+}
+
+// Answers "how many ways to chain from rating A to adapter B" for any pair, and follows adapters being added and
+// removed.  Counting is a product of 3x3 transfer matrices, one per rating:  the state at rating j is the number of
+// ways to reach j, j - 1 and j - 2, and rating j's matrix produces the next state from it (reaching j is the sum of
+// the old state if there's an adapter at j, otherwise impossible).  A segment tree over the ratings stores the product
+// for each node's range, so a query multiplies O(log n) node products, and adding or removing an adapter rebuilds
+// O(log n) of them.  The tree is over ratings rather than adapter indices so that updates don't shift anything.  Its
+// leaves are a power of two, and adding an adapter beyond the last one rebuilds the tree with the leaf count doubled
+// until it fits, which is O(n) but amortized like a growing vector.
+//
+// With modulus > 0 counts are reduced modulo it.  Otherwise they're exact, and any product entry that overflows becomes
+// ADAPTER_COUNT_OVERFLOW, which makes queries that use it fail even if the count they're after would fit.
+class AdapterArrangementTree
+{
+public:
+    static constexpr BigInt ADAPTER_COUNT_OVERFLOW = -1;
+
+    AdapterArrangementTree(const BitWordList& presence, BigInt maxJolt, BigInt modulus = 0) : m_modulus(modulus)
+    {
+        assert(modulus >= 0);
+
+        m_numLeaves = 1;
+        while (m_numLeaves <= maxJolt)
+            m_numLeaves *= 2;
+
+        // ratings past maxJolt have no adapters, so that they can be added later
+        m_nodes.resize(m_numLeaves * 2);
+        for (BigInt jolt = 0; jolt < m_numLeaves; ++jolt)
+        {
+            const BigInt wordIndex = jolt / NUM_BITS_PER_WORD;
+            const bool isPresent = (jolt <= maxJolt) && (wordIndex < (BigInt)presence.size())
+                                   && ((presence[wordIndex] >> (jolt % NUM_BITS_PER_WORD)) & 1);
+            m_nodes[m_numLeaves + jolt] = MakeTransferMatrix(isPresent);
+        }
+        BuildInternalNodes();
+    }
+
+    BigInt GetMaxJolt() const { return m_numLeaves - 1; }
+
+    // grows the tree if jolt is past GetMaxJolt()
+    void SetAdapter(BigInt jolt, bool isPresent)
+    {
+        assert(jolt > 0);
+        if (jolt >= m_numLeaves)
+            Grow(jolt);
+
+        BigInt node = m_numLeaves + jolt;
+        m_nodes[node] = MakeTransferMatrix(isPresent);
+        for (node /= 2; node > 0; node /= 2)
+            m_nodes[node] = Multiply(m_nodes[node * 2 + 1], m_nodes[node * 2]);
+    }
+
+    // fromJolt is where chains start (the outlet or an adapter), and toJolt needs an adapter for there to be any ways
+    bool CountArrangements(BigInt fromJolt, BigInt toJolt, BigInt& numWays) const
+    {
+        assert((fromJolt >= 0) && (fromJolt <= toJolt) && (toJolt < m_numLeaves));
+
+        // product of the matrices for (fromJolt, toJolt], with later ratings on the left
+        TransferMatrix lowerProduct = MakeIdentityMatrix();
+        TransferMatrix upperProduct = MakeIdentityMatrix();
+        for (BigInt lower = m_numLeaves + fromJolt + 1, upper = m_numLeaves + toJolt + 1; lower < upper;
+             lower /= 2, upper /= 2)
+        {
+            if (lower & 1)
+                lowerProduct = Multiply(m_nodes[lower++], lowerProduct);
+            if (upper & 1)
+                upperProduct = Multiply(upperProduct, m_nodes[--upper]);
+        }
+
+        // the chain starts with one way to reach fromJolt and none to reach the two ratings below it
+        const BigInt result = Multiply(upperProduct, lowerProduct).entries[0][0];
+        if (result == ADAPTER_COUNT_OVERFLOW)
+            return false;
+        numWays = result;
+        return true;
+    }
+
+private:
+    struct TransferMatrix
+    {
+        BigInt entries[3][3];
+    };
+
+    static TransferMatrix MakeIdentityMatrix()
+    {
+        TransferMatrix matrix = {};
+        for (BigInt i = 0; i < 3; ++i)
+            matrix.entries[i][i] = 1;
+        return matrix;
+    }
+
+    static TransferMatrix MakeTransferMatrix(bool isPresent)
+    {
+        TransferMatrix matrix = {};
+        for (BigInt i = 0; i < 3; ++i)
+            matrix.entries[0][i] = isPresent ? 1 : 0;
+        matrix.entries[1][0] = 1;
+        matrix.entries[2][1] = 1;
+        return matrix;
+    }
+
+    TransferMatrix Multiply(const TransferMatrix& lhs, const TransferMatrix& rhs) const
+    {
+        TransferMatrix product = {};
+        for (BigInt row = 0; row < 3; ++row)
+        {
+            for (BigInt column = 0; column < 3; ++column)
+            {
+                BigInt sum = 0;
+                for (BigInt i = 0; (i < 3) && (sum != ADAPTER_COUNT_OVERFLOW); ++i)
+                {
+                    const BigInt lhsEntry = lhs.entries[row][i];
+                    const BigInt rhsEntry = rhs.entries[i][column];
+                    if (m_modulus > 0)
+                    {
+                        sum = AddModulo(sum, MultiplyModulo(lhsEntry % m_modulus, rhsEntry % m_modulus, m_modulus), m_modulus);
+                        continue;
+                    }
+
+                    BigInt term = 0;
+                    if ((lhsEntry == ADAPTER_COUNT_OVERFLOW) || (rhsEntry == ADAPTER_COUNT_OVERFLOW)
+                        || !CheckedMultiply(lhsEntry, rhsEntry, term) || !CheckedAdd(sum, term, sum))
+                        sum = ADAPTER_COUNT_OVERFLOW;
+                }
+                product.entries[row][column] = sum;
+            }
+        }
+        return product;
+    }
+
+    void BuildInternalNodes()
+    {
+        for (BigInt node = m_numLeaves - 1; node > 0; --node)
+            m_nodes[node] = Multiply(m_nodes[node * 2 + 1], m_nodes[node * 2]);
+    }
+
+    // doubles the leaf count until maxJolt fits, keeping the existing leaves
+    void Grow(BigInt maxJolt)
+    {
+        BigInt newNumLeaves = m_numLeaves;
+        while (newNumLeaves <= maxJolt)
+            newNumLeaves *= 2;
+
+        std::vector<TransferMatrix> newNodes(newNumLeaves * 2, MakeTransferMatrix(false));
+        std::copy(m_nodes.cbegin() + m_numLeaves, m_nodes.cend(), newNodes.begin() + newNumLeaves);
+        m_nodes.swap(newNodes);
+        m_numLeaves = newNumLeaves;
+        BuildInternalNodes();
+    }
+
+    BigInt m_modulus;
+    BigInt m_numLeaves;
+    std::vector<TransferMatrix> m_nodes;
+};
+
+void PrintAdapterBitmapSummary(const char* arrayName, const BitWordList& presence)
+{
+    BigIntList gapHistogram;
+    CalcAdapterBitmapGapHistogram(presence, gapHistogram);
+    printf("%s from bitmap, gaps:  ", arrayName);
+    for (BigInt gap = 1; gap < (BigInt)gapHistogram.size(); ++gap)
+        printf("%lld of %lld  ", gapHistogram[gap], gap);
+    printf("product of 1 jolt and 3 jolt gaps = %lld\n", gapHistogram[1] * gapHistogram[3]);
+
+    BigIntMap contigStretches;
+    CalcAdapterBitmapStretches(presence, contigStretches);
+    printf("%s from bitmap, stretches:  ", arrayName);
+    for (auto iter = contigStretches.cbegin(); iter != contigStretches.cend(); ++iter)
+        printf("%lldn of %lld  ", iter->second, iter->first);
+
+    BigIntList sortedJolts;
+    GetAdapterBitmapJolts(presence, sortedJolts);
+    BigInt numWays = 0;
+    if (CalcNumWaysToConnectAdaptors(sortedJolts, 3, 0, numWays, false))
+        printf("num ways to connect adaptors = %lld\n", numWays);
+    else
+        printf("num ways to connect adaptors doesn't fit in 64 bits\n");
+}
+
+void RunAdapterArray()
+{
+    std::set<BigInt> testJoltsA;
+    ReadAdapterArray("Day10TestInputA.txt", testJoltsA, true);
+    printf("Test array A, product of 1 jolt and 3 jolt gaps = %lld\n", CalcProdAdaptor1JoltAnd3JoltGaps(testJoltsA, true));
+    const BigInt testNumWaysA = CalcNumWaysToConnectAdaptors(testJoltsA, true);
+    if (testNumWaysA >= 0)
+        printf("Test array A, num ways to connect adaptors = %lld\n", testNumWaysA);
+    else
+        printf("Test array A, num ways to connect adaptors doesn't fit in 64 bits\n");
+
+    std::set<BigInt> testJoltsB;
+    ReadAdapterArray("Day10TestInputB.txt", testJoltsB, true);
+    printf("Test array B, product of 1 jolt and 3 jolt gaps = %lld\n", CalcProdAdaptor1JoltAnd3JoltGaps(testJoltsB, true));
+    const BigInt testNumWaysB = CalcNumWaysToConnectAdaptors(testJoltsB, true);
+    if (testNumWaysB >= 0)
+        printf("Test array B, num ways to connect adaptors = %lld\n", testNumWaysB);
+    else
+        printf("Test array B, num ways to connect adaptors doesn't fit in 64 bits\n");
+
+    std::set<BigInt> mainJolts;
+    ReadAdapterArray("Day10Input.txt", mainJolts, false);
+    printf("Main array, product of 1 jolt and 3 jolt gaps = %lld\n", CalcProdAdaptor1JoltAnd3JoltGaps(mainJolts, false));
+    const BigInt mainNumWays = CalcNumWaysToConnectAdaptors(mainJolts, true);
+    if (mainNumWays >= 0)
+        printf("Main array, num ways to connect adaptors = %lld\n", mainNumWays);
+    else
+        printf("Main array, num ways to connect adaptors doesn't fit in 64 bits\n");
+
+    BigInt numWays = 0;
+    if (CalcNumWaysToConnectAdaptors(mainJolts, 4, 0, numWays, false))
+        printf("Main array, num ways to connect adaptors accepting 4-jolt gaps = %lld\n", numWays);
+    else
+        printf("Main array, num ways to connect adaptors accepting 4-jolt gaps doesn't fit in 64 bits\n");
+
+    // every rating from 1 to 1000, so there are 1-, 2- and 3-jolt steps everywhere
+    BigIntList denseJolts(1000);
+    for (BigInt i = 0; i < (BigInt)denseJolts.size(); ++i)
+        denseJolts[i] = i + 1;
+    if (!CalcNumWaysToConnectAdaptors(denseJolts, 3, 0, numWays, false))
+        printf("Dense array, num ways to connect adaptors doesn't fit in 64 bits\n");
+    CalcNumWaysToConnectAdaptors(denseJolts, 3, 1000000007, numWays, false);
+    printf("Dense array, num ways to connect adaptors modulo 1000000007 = %lld\n", numWays);
+
+    // with ratings 1 to 10 and steps of at most 2, the counts are Fibonacci numbers;  with steps of 1 there's one way
+    const BigIntList shortJolts(denseJolts.cbegin(), denseJolts.cbegin() + 10);
+    CalcNumWaysToConnectAdaptors(shortJolts, 1, 0, numWays, false);
+    assert(numWays == 1);
+    printf("Ratings 1 to 10, num ways to connect adaptors accepting only 1-jolt gaps = %lld\n", numWays);
+    CalcNumWaysToConnectAdaptors(shortJolts, 2, 0, numWays, false);
+    assert(numWays == 89);
+    printf("Ratings 1 to 10, num ways to connect adaptors accepting 1- and 2-jolt gaps = %lld\n", numWays);
+
+    BitWordList presence;
+    ReadAdapterBitmap("Day10TestInputA.txt", presence);
+    PrintAdapterBitmapSummary("Test array A", presence);
+    ReadAdapterBitmap("Day10TestInputB.txt", presence);
+    PrintAdapterBitmapSummary("Test array B", presence);
+    ReadAdapterBitmap("Day10Input.txt", presence);
+    PrintAdapterBitmapSummary("Main array", presence);
+
+    BigIntList sortedJolts;
+    GetAdapterBitmapJolts(presence, sortedJolts);
+    AdapterArrangementTree arrangementTree(presence, sortedJolts.back());
+    const BigInt midJolt = sortedJolts[sortedJolts.size() / 2];
+    BigInt numWaysToMid = 0;
+    BigInt numWaysFromMid = 0;
+    if (arrangementTree.CountArrangements(0, sortedJolts.back(), numWays)
+        && arrangementTree.CountArrangements(0, midJolt, numWaysToMid)
+        && arrangementTree.CountArrangements(midJolt, sortedJolts.back(), numWaysFromMid))
+        printf(
+            "Main array from arrangement tree, num ways to connect adaptors = %lld, %lld up to %lld and %lld from there\n",
+            numWays,
+            numWaysToMid,
+            midJolt,
+            numWaysFromMid);
+    else
+        printf("Main array from arrangement tree, num ways to connect adaptors doesn't fit in 64 bits\n");
+
+    // removing an adapter only changes the tree along one path
+    const BigInt removedJolt = sortedJolts[sortedJolts.size() / 3];
+    arrangementTree.SetAdapter(removedJolt, false);
+    bool treeFits = arrangementTree.CountArrangements(0, sortedJolts.back(), numWays);
+    sortedJolts.erase(std::find(sortedJolts.begin(), sortedJolts.end(), removedJolt));
+    BigInt recountedNumWays = 0;
+    bool recountFits = CalcNumWaysToConnectAdaptors(sortedJolts, 3, 0, recountedNumWays, false);
+    if (treeFits && recountFits)
+        printf(
+            "Without adapter %lld, num ways to connect adaptors = %lld from the tree, %lld counted from scratch\n",
+            removedJolt,
+            numWays,
+            recountedNumWays);
+    else
+        printf("Without adapter %lld, num ways to connect adaptors doesn't fit in 64 bits\n", removedJolt);
+
+    // adapters every 3 jolts past the top don't change the count, but take the tree past its leaves
+    const BigInt oldMaxJolt = arrangementTree.GetMaxJolt();
+    for (BigInt jolt = sortedJolts.back() + 3; jolt <= oldMaxJolt + 3; jolt += 3)
+    {
+        arrangementTree.SetAdapter(jolt, true);
+        sortedJolts.push_back(jolt);
+    }
+    treeFits = arrangementTree.CountArrangements(0, sortedJolts.back(), numWays);
+    recountFits = CalcNumWaysToConnectAdaptors(sortedJolts, 3, 0, recountedNumWays, false);
+    if (treeFits && recountFits)
+        printf(
+            "With adapters every 3 jolts up to %lld, the tree grew from ratings up to %lld to %lld, num ways to connect adaptors = %lld from the tree, %lld counted from scratch\n",
+            sortedJolts.back(),
+            oldMaxJolt,
+            arrangementTree.GetMaxJolt(),
+            numWays,
+            recountedNumWays);
+    else
+        printf(
+            "With adapters every 3 jolts up to %lld, the tree grew from ratings up to %lld to %lld, num ways to connect adaptors doesn't fit in 64 bits\n",
+            sortedJolts.back(),
+            oldMaxJolt,
+            arrangementTree.GetMaxJolt());
+}
+
+
+////////////////////////////
+// Problem 11 - Seating System
+
+// The layout is stored row-major in one buffer, with row y starting at y * m_stride.  Generations are double-buffered,
+// so neither stepping nor Reset allocates.
+class SeatingLayout
+{
+public:
+    SeatingLayout(const char* fileName, bool verbose) : m_numSeatsX(0), m_numSeatsY(0), m_stride(0)
+    {
+        StringList lines;
+        ReadFileLines(fileName, lines);
+
+        if (verbose)
+            printf("Read seating layout from %s:\n", fileName);
+
+        m_numSeatsX = lines[0].length();
+        m_numSeatsY = (BigInt)lines.size();
+        m_stride = m_numSeatsX;
+
+        m_origSeats.resize(m_stride * m_numSeatsY);
+        for (BigInt y = 0; y < m_numSeatsY; ++y)
+        {
+            assert(lines[y].length() == m_numSeatsX);
+            memcpy(&m_origSeats[y * m_stride], lines[y].data(), m_numSeatsX);
+        }
+
+        m_seats = m_origSeats;
+        m_nextSeats.resize(m_origSeats.size());
+
+        if (verbose)
+            PrintLayout();
+    }
+
+    void Reset() { memcpy(m_seats.data(), m_origSeats.data(), m_origSeats.size()); }
+
+    BigInt GetNumSeatsX() const { return m_numSeatsX; }
+    BigInt GetNumSeatsY() const { return m_numSeatsY; }
+    char GetLocationState(BigInt x, BigInt y) const { return m_seats[y * m_stride + x]; }
+
+    void StepForwardUntilNothingChanges(BigInt seeingDistance, BigInt maxSeenOccupied, bool verbose)
+    {
+        if (verbose)
+        {
+            printf("Initial state:\n");
+            PrintLayout();
+        }
+        for (;;)
+        {
+            bool somethingChanged = false;
+            StepForward(seeingDistance, maxSeenOccupied, &somethingChanged);
+
+            if (!somethingChanged)
+            {
+                if (verbose)
+                    printf("State settled!\n");
+                break;
+            }
+
+            if (verbose)
+            {
+                printf("Next state:\n");
+                PrintLayout();
+            }
+        }
+    }
+
+    void StepForward(BigInt seeingDistance, BigInt maxSeenOccupied, bool* pSomethingChanged = nullptr)
+    {
+        bool somethingChanged = false;
+        for (BigInt y = 0; y < m_numSeatsY; ++y)
+        {
+            char* pRow = &m_nextSeats[y * m_stride];
+            for (BigInt x = 0; x < m_numSeatsX; ++x)
+            {
+                const char locState = GetLocationState(x, y);
+                switch (locState)
+                {
+                    case 'L':
+                        if (CountOccupiedSeatsSeen(x, y, seeingDistance) <= 0)
+                        {
+                            pRow[x] = '#';
+                            somethingChanged = true;
+                        }
+                        else
+                        {
+                            pRow[x] = 'L';
+                        }
+                        break;
+                    case '#':
+                        if (CountOccupiedSeatsSeen(x, y, seeingDistance) >= maxSeenOccupied)
+                        {
+                            pRow[x] = 'L';
+                            somethingChanged = true;
+                        }
+                        else
+                        {
+                            pRow[x] = '#';
+                        }
+                        break;
+                    default:
+                        assert(locState == '.');
+                        pRow[x] = '.';
+                        break;
+                }
+            }
+        }
+
+        m_seats.swap(m_nextSeats);
+        if (pSomethingChanged)
+            *pSomethingChanged = somethingChanged;
+    }
+
+    void PrintLayout()
+    {
+        for (BigInt y = 0; y < m_numSeatsY; ++y)
+            printf("  %.*s\n", (int)m_numSeatsX, &m_seats[y * m_stride]);
+    }
+
+    BigInt CountLocationStatesOfType(char type) const
+    {
+        BigInt count = 0;
+        for (BigInt y = 0; y < m_numSeatsY; ++y)
+        {
+            const char* pRow = &m_seats[y * m_stride];
+            count += std::count(pRow, pRow + m_numSeatsX, type);
+        }
+        return count;
+    }
+
+
+private:
+    BigInt CountOccupiedSeatsSeen(BigInt x, BigInt y, BigInt seeingDistance) const
+    {
+        BigInt count = 0;
+
+        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, +1, 0);
+        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, +1, +1);
+        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, 0, +1);
+        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, -1, +1);
+        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, -1, 0);
+        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, -1, -1);
+        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, 0, -1);
+        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, +1, -1);
+
+        return count;
+    }
+
+    bool CanSeeOccupiedSeatInDirection(BigInt x, BigInt y, BigInt seeingDistance, BigInt xDir, BigInt yDir) const
+    {
+        assert((xDir == -1) || (xDir == 0) || (xDir == +1));
+        assert((yDir == -1) || (yDir == 0) || (yDir == +1));
+        assert((xDir != 0) || (yDir != 0));
+
+        for (BigInt i = 0; (seeingDistance < 0) || (i < seeingDistance); ++i)
+        {
+            x += xDir;
+            y += yDir;
+
+            if ((x < 0) || (x >= m_numSeatsX) || (y < 0) || (y >= m_numSeatsY))
+                return false;
+
+            const char seenSpotType = GetLocationState(x, y);
+            if (seenSpotType == '#')
+                return true;
+            if (seenSpotType == 'L')
+                return false;
+
+            assert(seenSpotType == '.');
+        }
+
+        return false;
+    }
+
+    std::vector<char> m_origSeats;
+    std::vector<char> m_seats;
+    std::vector<char> m_nextSeats;
+    BigInt m_numSeatsX;
+    BigInt m_numSeatsY;
+    BigInt m_stride;
+};
+
+// Distance-1 rule (seeingDistance == 1) on bitplanes:  each row is a run of 64-bit words with one bit per location,
+// with one plane for where the seats are and two for occupancy (this generation and the next, swapped after each step).
+// Neighbor counts for 64 locations at a time come out of bit-sliced adders, as four planes holding the binary digits
+// of the counts.  Rows are padded with an empty row above and below, so every row has neighbors to read.
+class SeatingBitEngine
+{
+public:
+    SeatingBitEngine(const SeatingLayout& layout)
+        : m_numSeatsX(layout.GetNumSeatsX())
+        , m_numSeatsY(layout.GetNumSeatsY())
+        , m_numWordsPerRow((layout.GetNumSeatsX() + NUM_BITS_PER_WORD - 1) / NUM_BITS_PER_WORD)
+        , m_currentBuffer(0)
+    {
+        const BigInt numWords = m_numWordsPerRow * (m_numSeatsY + 2);
+        m_seatMask.resize(numWords, 0);
+        m_initialOccupied.resize(numWords, 0);
+        for (BigInt y = 0; y < m_numSeatsY; ++y)
+        {
+            for (BigInt x = 0; x < m_numSeatsX; ++x)
+            {
+                const char locState = layout.GetLocationState(x, y);
+                const BigInt wordIndex = CalcWordIndex(x, y);
+                const BigUInt bit = 1ULL << (x % NUM_BITS_PER_WORD);
+                if (locState != '.')
+                    m_seatMask[wordIndex] |= bit;
+                if (locState == '#')
+                    m_initialOccupied[wordIndex] |= bit;
+            }
+        }
+
+        m_occupied[0] = m_initialOccupied;
+        m_occupied[1].resize(numWords, 0);
+    }
+
+    void Reset()
+    {
+        m_occupied[0] = m_initialOccupied;
+        m_currentBuffer = 0;
+    }
+
+    char GetLocationState(BigInt x, BigInt y) const
+    {
+        const BigInt wordIndex = CalcWordIndex(x, y);
+        const BigInt bitIndex = x % NUM_BITS_PER_WORD;
+        if (!((m_seatMask[wordIndex] >> bitIndex) & 1))
+            return '.';
+        return ((m_occupied[m_currentBuffer][wordIndex] >> bitIndex) & 1) ? '#' : 'L';
+    }
+
+    BigInt CountOccupiedSeats() const
+    {
+        BigInt count = 0;
+        for (BigUInt word: m_occupied[m_currentBuffer])
+            count += CountSetBits(word);
+        return count;
+    }
+
+    void StepForwardUntilNothingChanges(BigInt maxSeenOccupied)
+    {
+        bool somethingChanged = true;
+        while (somethingChanged)
+            StepForward(maxSeenOccupied, &somethingChanged);
+    }
+
+    // same as StepForwardUntilNothingChanges, with rows split into bands stepped on numThreads threads (0 for one per
+    // core), returns the number of occupied seats
+    BigInt StepForwardUntilNothingChangesInParallel(BigInt maxSeenOccupied, BigInt numThreads = 0)
+    {
+        return StepRowBandsUntilNothingChanges(
+            m_numSeatsY,
+            numThreads,
+            [&](BigInt rowBegin, BigInt rowEnd, BigInt& numOccupied) {
+                return StepRows(rowBegin, rowEnd, maxSeenOccupied, numOccupied);
+            },
+            [&]() { m_currentBuffer ^= 1; });
+    }
+
+    void StepForward(BigInt maxSeenOccupied, bool* pSomethingChanged = nullptr)
+    {
+        BigInt numOccupied = 0;
+        const bool somethingChanged = StepRows(0, m_numSeatsY, maxSeenOccupied, numOccupied);
+        m_currentBuffer ^= 1;
+        if (pSomethingChanged)
+            *pSomethingChanged = somethingChanged;
+    }
+
+private:
+    BigInt CalcWordIndex(BigInt x, BigInt y) const { return (y + 1) * m_numWordsPerRow + x / NUM_BITS_PER_WORD; }
+
+    static void AddBits(BigUInt a, BigUInt b, BigUInt c, BigUInt& sum, BigUInt& carry)
+    {
+        const BigUInt partialSum = a ^ b;
+        sum = partialSum ^ c;
+        carry = (a & b) | (partialSum & c);
+    }
+
+    // bit-sliced countDigits[0] + 2 * countDigits[1] + 4 * countDigits[2] + 8 * countDigits[3] >= threshold,
+    // compared digit by digit from the top
+    static BigUInt CalcCountsAtLeast(const BigUInt countDigits[4], BigInt threshold)
+    {
+        if (threshold <= 0)
+            return ~0ULL;
+        if (threshold > 8)
+            return 0;
+
+        BigUInt greater = 0;
+        BigUInt equal = ~0ULL;
+        for (BigInt digit = 3; digit >= 0; --digit)
+        {
+            if ((threshold >> digit) & 1)
+            {
+                equal &= countDigits[digit];
+            }
+            else
+            {
+                greater |= equal & countDigits[digit];
+                equal &= ~countDigits[digit];
+            }
+        }
+        return greater | equal;
+    }
+
+    // Writes the next generation of rows [rowBegin, rowEnd) to the other buffer, and how many of their seats are
+    // occupied in it to numOccupied.  Returns true if any seat changed.  Only reads the current buffer, so bands of
+    // rows can be stepped at the same time.
+    bool StepRows(BigInt rowBegin, BigInt rowEnd, BigInt maxSeenOccupied, BigInt& numOccupied)
+    {
+        numOccupied = 0;
+        const BitWordList& occupied = m_occupied[m_currentBuffer];
+        BitWordList& nextOccupied = m_occupied[m_currentBuffer ^ 1];
+
+        BigUInt changedBits = 0;
+        for (BigInt y = rowBegin; y < rowEnd; ++y)
+        {
+            const BigUInt* pAbove = &occupied[y * m_numWordsPerRow];
+            const BigUInt* pRow = pAbove + m_numWordsPerRow;
+            const BigUInt* pBelow = pRow + m_numWordsPerRow;
+            const BigUInt* pSeats = &m_seatMask[(y + 1) * m_numWordsPerRow];
+            BigUInt* pNext = &nextOccupied[(y + 1) * m_numWordsPerRow];
+
+            for (BigInt w = 0; w < m_numWordsPerRow; ++w)
+            {
+                const bool hasPrevWord = (w > 0);
+                const bool hasNextWord = (w + 1 < m_numWordsPerRow);
+
+                // bit x of the ...Left planes is location x - 1, bit x of the ...Right planes is location x + 1
+                const BigUInt above = pAbove[w];
+                const BigUInt aboveLeft = (above << 1) | (hasPrevWord ? (pAbove[w - 1] >> 63) : 0);
+                const BigUInt aboveRight = (above >> 1) | (hasNextWord ? (pAbove[w + 1] << 63) : 0);
+                const BigUInt row = pRow[w];
+                const BigUInt rowLeft = (row << 1) | (hasPrevWord ? (pRow[w - 1] >> 63) : 0);
+                const BigUInt rowRight = (row >> 1) | (hasNextWord ? (pRow[w + 1] << 63) : 0);
+                const BigUInt below = pBelow[w];
+                const BigUInt belowLeft = (below << 1) | (hasPrevWord ? (pBelow[w - 1] >> 63) : 0);
+                const BigUInt belowRight = (below >> 1) | (hasNextWord ? (pBelow[w + 1] << 63) : 0);
+
+                // count the 8 neighbors into ones + 2 * twos + 4 * fours + 8 * eights
+                BigUInt aboveSum, aboveCarry, belowSum, belowCarry, rowSum, rowCarry;
+                AddBits(aboveLeft, above, aboveRight, aboveSum, aboveCarry);
+                AddBits(belowLeft, below, belowRight, belowSum, belowCarry);
+                AddBits(rowLeft, rowRight, 0, rowSum, rowCarry);
+
+                BigUInt ones, onesCarry, twosPartial, twosCarry, twos, twosPartialCarry;
+                AddBits(aboveSum, belowSum, rowSum, ones, onesCarry);
+                AddBits(aboveCarry, belowCarry, rowCarry, twosPartial, twosCarry);
+                AddBits(twosPartial, onesCarry, 0, twos, twosPartialCarry);
+                const BigUInt fours = twosCarry ^ twosPartialCarry;
+                const BigUInt eights = twosCarry & twosPartialCarry;
+
+                const BigUInt countDigits[4] = { ones, twos, fours, eights };
+                const BigUInt noneSeen = ~(ones | twos | fours | eights);
+                const BigUInt tooManySeen = CalcCountsAtLeast(countDigits, maxSeenOccupied);
+
+                const BigUInt next = pSeats[w] & ((row & ~tooManySeen) | (~row & noneSeen));
+                changedBits |= next ^ row;
+                numOccupied += CountSetBits(next);
+                pNext[w] = next;
+            }
+        }
+
+        return changedBits != 0;
+    }
+
+    BigInt m_numSeatsX;
+    BigInt m_numSeatsY;
+    BigInt m_numWordsPerRow;
+    BitWordList m_seatMask;
+    BitWordList m_initialOccupied;
+    BitWordList m_occupied[2];
+    BigInt m_currentBuffer;
+};
+
+// The seats each seat can see under a given seeing distance, which only depend on where the floor is:  seats are
+// numbered in row-major order, and each one gets exactly NUM_SEEN_SEAT_SLOTS neighbor indices, with directions that
+// don't reach a seat pointing at an extra always-empty seat numbered GetNumSeats().  Simulations can then count what a
+// seat sees with fixed gathers, however sparse the seats are.
+class SeatingNeighborTable
+{
+public:
+    static constexpr BigInt NUM_SEEN_SEAT_SLOTS = 8;
+    static constexpr uint32_t NO_SEAT = UINT32_MAX;
+
+    SeatingNeighborTable(const SeatingLayout& layout, BigInt seeingDistance)
+        : m_numSeatsX(layout.GetNumSeatsX()), m_numSeatsY(layout.GetNumSeatsY()), m_numSeats(0)
+    {
+        m_locationSeatIndices.resize(m_numSeatsX * m_numSeatsY, NO_SEAT);
+        m_rowSeatOffsets.resize(m_numSeatsY + 1, 0);
+        for (BigInt y = 0; y < m_numSeatsY; ++y)
+        {
+            m_rowSeatOffsets[y] = m_numSeats;
+            for (BigInt x = 0; x < m_numSeatsX; ++x)
+            {
+                const char locState = layout.GetLocationState(x, y);
+                if (locState == '.')
+                    continue;
+                m_locationSeatIndices[y * m_numSeatsX + x] = (uint32_t)m_numSeats++;
+                m_initialOccupied.push_back((locState == '#') ? 1 : 0);
+            }
+        }
+        m_rowSeatOffsets[m_numSeatsY] = m_numSeats;
+        assert(m_numSeats < (BigInt)NO_SEAT);
+
+        static const BigInt s_dirs[NUM_SEEN_SEAT_SLOTS][2] = {
+            { +1, 0 }, { +1, +1 }, { 0, +1 }, { -1, +1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { +1, -1 }
+        };
+        m_seenSeats.resize(m_numSeats * NUM_SEEN_SEAT_SLOTS, (uint32_t)m_numSeats);
+        for (BigInt y = 0; y < m_numSeatsY; ++y)
+        {
+            for (BigInt x = 0; x < m_numSeatsX; ++x)
+            {
+                const uint32_t seatIndex = m_locationSeatIndices[y * m_numSeatsX + x];
+                if (seatIndex == NO_SEAT)
+                    continue;
+
+                for (BigInt dir = 0; dir < NUM_SEEN_SEAT_SLOTS; ++dir)
+                {
+                    BigInt seenX = x;
+                    BigInt seenY = y;
+                    for (BigInt i = 0; (seeingDistance < 0) || (i < seeingDistance); ++i)
+                    {
+                        seenX += s_dirs[dir][0];
+                        seenY += s_dirs[dir][1];
+                        if ((seenX < 0) || (seenX >= m_numSeatsX) || (seenY < 0) || (seenY >= m_numSeatsY))
+                            break;
+
+                        const uint32_t seenSeatIndex = m_locationSeatIndices[seenY * m_numSeatsX + seenX];
+                        if (seenSeatIndex != NO_SEAT)
+                        {
+                            m_seenSeats[seatIndex * NUM_SEEN_SEAT_SLOTS + dir] = seenSeatIndex;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    BigInt GetNumSeatsX() const { return m_numSeatsX; }
+    BigInt GetNumSeatsY() const { return m_numSeatsY; }
+    BigInt GetNumSeats() const { return m_numSeats; }
+
+    // NO_SEAT for floor
+    uint32_t GetSeatIndex(BigInt x, BigInt y) const { return m_locationSeatIndices[y * m_numSeatsX + x]; }
+    // seats in row y are [GetRowSeatOffset(y), GetRowSeatOffset(y + 1))
+    BigInt GetRowSeatOffset(BigInt y) const { return m_rowSeatOffsets[y]; }
+    const uint32_t* GetSeenSeats(BigInt seatIndex) const { return &m_seenSeats[seatIndex * NUM_SEEN_SEAT_SLOTS]; }
+    const std::vector<uint8_t>& GetInitialOccupied() const { return m_initialOccupied; }
+
+private:
+    BigInt m_numSeatsX;
+    BigInt m_numSeatsY;
+    BigInt m_numSeats;
+    std::vector<uint32_t> m_locationSeatIndices;
+    BigIntList m_rowSeatOffsets;
+    std::vector<uint32_t> m_seenSeats;
+    std::vector<uint8_t> m_initialOccupied;
+};
+
+// Runs the seating rules over a SeatingNeighborTable, with a byte of occupancy per seat (plus the always-empty seat the
+// missing neighbors point at), double-buffered.  Several simulators can share one table.
+class SeatingSimulator
+{
+public:
+    SeatingSimulator(const SeatingNeighborTable& table) : m_table(table), m_currentBuffer(0)
+    {
+        for (std::vector<uint8_t>& occupied: m_occupied)
+            occupied.resize(table.GetNumSeats() + 1, 0);
+        Reset();
+    }
 
-        m_origSeats = m_seats;
+    void Reset()
+    {
+        const std::vector<uint8_t>& initialOccupied = m_table.GetInitialOccupied();
+        std::copy(initialOccupied.cbegin(), initialOccupied.cend(), m_occupied[0].begin());
+        m_currentBuffer = 0;
+    }
 
-        if (verbose)
-            PrintLayout();
+    char GetLocationState(BigInt x, BigInt y) const
+    {
+        const uint32_t seatIndex = m_table.GetSeatIndex(x, y);
+        if (seatIndex == SeatingNeighborTable::NO_SEAT)
+            return '.';
+        return m_occupied[m_currentBuffer][seatIndex] ? '#' : 'L';
     }
 
-    void Reset() { m_seats = m_origSeats; }
+    BigInt CountOccupiedSeats() const
+    {
+        const std::vector<uint8_t>& occupied = m_occupied[m_currentBuffer];
+        return std::count(occupied.cbegin(), occupied.cend(), 1);
+    }
 
-    char GetLocationState(BigInt x, BigInt y) const { return m_seats[y][x]; }
+    void StepForwardUntilNothingChanges(BigInt maxSeenOccupied)
+    {
+        bool somethingChanged = true;
+        while (somethingChanged)
+            StepForward(maxSeenOccupied, &somethingChanged);
+    }
 
-    void StepForwardUntilNothingChanges(BigInt seeingDistance, BigInt maxSeenOccupied, bool verbose)
+    // Same result as StepForwardUntilNothingChanges, but after the first generation only the seats that changed or see
+    // a seat that changed are evaluated, since nothing else can change.  Seeing is symmetric (the first seat along a
+    // ray sees this seat as the first seat along the opposite ray), so those are the changed seats and the seats they
+    // see.  Changes are applied in place once all the dirty seats have been evaluated.  With maxGenerations >= 0, gives
+    // up (returning false) if the layout hasn't settled after that many generations, since some rules oscillate.
+    bool StepForwardUntilNothingChangesIncremental(
+        BigInt maxSeenOccupied,
+        BigInt* pNumGenerations = nullptr,
+        BigInt* pNumEvaluations = nullptr,
+        BigInt maxGenerations = -1)
     {
-        if (verbose)
-        {
-            printf("Initial state:\n");
-            PrintLayout();
-        }
+        const BigInt numSeats = m_table.GetNumSeats();
+        uint8_t* pOccupied = m_occupied[m_currentBuffer].data();
+
+        std::vector<uint32_t> dirtySeats(numSeats);
+        for (BigInt seatIndex = 0; seatIndex < numSeats; ++seatIndex)
+            dirtySeats[seatIndex] = (uint32_t)seatIndex;
+        std::vector<uint32_t> changedSeats;
+        // generation each seat was last made dirty for, so it's only added once
+        BigIntList dirtyGenerations(numSeats, 0);
+
+        BigInt numGenerations = 0;
+        BigInt numEvaluations = 0;
+        bool settled = false;
         for (;;)
         {
-            bool somethingChanged = false;
-            StepForward(seeingDistance, maxSeenOccupied, &somethingChanged);
-
-            if (!somethingChanged)
+            changedSeats.clear();
+            for (const uint32_t seatIndex: dirtySeats)
             {
-                if (verbose)
-                    printf("State settled!\n");
-                break;
+                if (CalcNextOccupied(pOccupied, seatIndex, maxSeenOccupied) != pOccupied[seatIndex])
+                    changedSeats.push_back(seatIndex);
             }
-
-            if (verbose)
+            numEvaluations += (BigInt)dirtySeats.size();
+            if (changedSeats.empty())
             {
-                printf("Next state:\n");
-                PrintLayout();
+                settled = true;
+                break;
             }
-        }
-    }
-
-    void StepForward(BigInt seeingDistance, BigInt maxSeenOccupied, bool* pSomethingChanged = nullptr)
-    {
-        StringList newSeats;
-        newSeats.resize(m_numSeatsY);
-
-        bool somethingChanged = false;
-        for (BigInt y = 0; y < m_numSeatsY; ++y)
-        {
-            std::string& row = newSeats[y];
+            if (numGenerations == maxGenerations)
+                break;
+            ++numGenerations;
 
-            row.clear();
-            for (BigInt x = 0; x < m_numSeatsX; ++x)
+            dirtySeats.clear();
+            for (const uint32_t seatIndex: changedSeats)
             {
-                const char locState = GetLocationState(x, y);
-                switch (locState)
+                pOccupied[seatIndex] ^= 1;
+
+                if (dirtyGenerations[seatIndex] != numGenerations)
                 {
-                    case 'L':
-                        if (CountOccupiedSeatsSeen(x, y, seeingDistance) <= 0)
-                        {
-                            row += '#';
-                            somethingChanged = true;
-                        }
-                        else
-                        {
-                            row += 'L';
-                        }
-                        break;
-                    case '#':
-                        if (CountOccupiedSeatsSeen(x, y, seeingDistance) >= maxSeenOccupied)
-                        {
-                            row += 'L';
-                            somethingChanged = true;
-                        }
-                        else
-                        {
-                            row += '#';
-                        }
-                        break;
-                    default:
-                        assert(locState == '.');
-                        row += '.';
-                        break;
+                    dirtyGenerations[seatIndex] = numGenerations;
+                    dirtySeats.push_back(seatIndex);
+                }
+                const uint32_t* pSeenSeats = m_table.GetSeenSeats(seatIndex);
+                for (BigInt slot = 0; slot < SeatingNeighborTable::NUM_SEEN_SEAT_SLOTS; ++slot)
+                {
+                    const uint32_t seenSeatIndex = pSeenSeats[slot];
+                    if ((seenSeatIndex < numSeats) && (dirtyGenerations[seenSeatIndex] != numGenerations))
+                    {
+                        dirtyGenerations[seenSeatIndex] = numGenerations;
+                        dirtySeats.push_back(seenSeatIndex);
+                    }
                 }
             }
         }
 
-        m_seats.swap(newSeats);
-        if (pSomethingChanged)
-            *pSomethingChanged = somethingChanged;
+        if (pNumGenerations)
+            *pNumGenerations = numGenerations;
+        if (pNumEvaluations)
+            *pNumEvaluations = numEvaluations;
+        return settled;
     }
 
-    void PrintLayout()
+    // same as StepForwardUntilNothingChanges, with rows split into bands stepped on numThreads threads (0 for one per
+    // core), returns the number of occupied seats
+    BigInt StepForwardUntilNothingChangesInParallel(BigInt maxSeenOccupied, BigInt numThreads = 0)
     {
-        for (BigInt i = 0; i < (BigInt)m_seats.size(); ++i)
-            printf("  %s\n", m_seats[i].c_str());
+        return StepRowBandsUntilNothingChanges(
+            m_table.GetNumSeatsY(),
+            numThreads,
+            [&](BigInt rowBegin, BigInt rowEnd, BigInt& numOccupied) {
+                return StepSeats(
+                    m_table.GetRowSeatOffset(rowBegin), m_table.GetRowSeatOffset(rowEnd), maxSeenOccupied, numOccupied);
+            },
+            [&]() { m_currentBuffer ^= 1; });
     }
 
-    BigInt CountLocationStatesOfType(char type) const
+    void StepForward(BigInt maxSeenOccupied, bool* pSomethingChanged = nullptr)
     {
-        BigInt count = 0;
-        for (BigInt y = 0; y < m_numSeatsY; ++y)
-        {
-            const std::string& row = m_seats[y];
-            count += std::count(row.cbegin(), row.cend(), type);
-        }
-        return count;
+        BigInt numOccupied = 0;
+        const bool somethingChanged = StepSeats(0, m_table.GetNumSeats(), maxSeenOccupied, numOccupied);
+        m_currentBuffer ^= 1;
+        if (pSomethingChanged)
+            *pSomethingChanged = somethingChanged;
     }
 
-
 private:
-    BigInt CountOccupiedSeatsSeen(BigInt x, BigInt y, BigInt seeingDistance) const
+    uint8_t CalcNextOccupied(const uint8_t* pOccupied, BigInt seatIndex, BigInt maxSeenOccupied) const
     {
-        BigInt count = 0;
-
-        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, +1, 0);
-        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, +1, +1);
-        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, 0, +1);
-        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, -1, +1);
-        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, -1, 0);
-        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, -1, -1);
-        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, 0, -1);
-        count += CanSeeOccupiedSeatInDirection(x, y, seeingDistance, +1, -1);
+        const uint32_t* pSeenSeats = m_table.GetSeenSeats(seatIndex);
+        BigInt numSeenOccupied = 0;
+        for (BigInt slot = 0; slot < SeatingNeighborTable::NUM_SEEN_SEAT_SLOTS; ++slot)
+            numSeenOccupied += pOccupied[pSeenSeats[slot]];
 
-        return count;
+        return pOccupied[seatIndex] ? (numSeenOccupied < maxSeenOccupied) : (numSeenOccupied == 0);
     }
 
-    bool CanSeeOccupiedSeatInDirection(BigInt x, BigInt y, BigInt seeingDistance, BigInt xDir, BigInt yDir) const
+    // Writes the next generation of seats [seatBegin, seatEnd) to the other buffer, and how many of them are occupied
+    // in it to numOccupied.  Returns true if any seat changed.  Only reads the current buffer, so ranges of seats can
+    // be stepped at the same time.
+    bool StepSeats(BigInt seatBegin, BigInt seatEnd, BigInt maxSeenOccupied, BigInt& numOccupied)
     {
-        assert((xDir == -1) || (xDir == 0) || (xDir == +1));
-        assert((yDir == -1) || (yDir == 0) || (yDir == +1));
-        assert((xDir != 0) || (yDir != 0));
+        numOccupied = 0;
+        const uint8_t* pOccupied = m_occupied[m_currentBuffer].data();
+        uint8_t* pNextOccupied = m_occupied[m_currentBuffer ^ 1].data();
 
-        for (BigInt i = 0; (seeingDistance < 0) || (i < seeingDistance); ++i)
+        bool somethingChanged = false;
+        for (BigInt seatIndex = seatBegin; seatIndex < seatEnd; ++seatIndex)
         {
-            x += xDir;
-            y += yDir;
-
-            if ((x < 0) || (x >= m_numSeatsX) || (y < 0) || (y >= m_numSeatsY))
-                return false;
-
-            const char seenSpotType = m_seats[y][x];
-            if (seenSpotType == '#')
-                return true;
-            if (seenSpotType == 'L')
-                return false;
-
-            assert(seenSpotType == '.');
+            const uint8_t nextOccupied = CalcNextOccupied(pOccupied, seatIndex, maxSeenOccupied);
+            somethingChanged |= (nextOccupied != pOccupied[seatIndex]);
+            numOccupied += nextOccupied;
+            pNextOccupied[seatIndex] = nextOccupied;
         }
-
-        return false;
+        return somethingChanged;
     }
 
-    StringList m_origSeats;
-    StringList m_seats;
-    BigInt m_numSeatsX;
-    BigInt m_numSeatsY;
+    const SeatingNeighborTable& m_table;
+    std::vector<uint8_t> m_occupied[2];
+    BigInt m_currentBuffer;
 };
 
+// Settles the layout under every combination of seeing distance and max seen occupants.  Each distance's neighbor
+// table is built once, and every combination then runs on its own simulator over the shared table, with worker threads
+// taking tables and then combinations as they free up.  settledCounts[i][j] is the number of occupied seats for
+// seeingDistances[i] and maxSeenOccupieds[j], or -1 if that combination didn't settle within maxGenerations.
+void SweepSeatingRules(
+    const SeatingLayout& layout,
+    const BigIntList& seeingDistances,
+    const BigIntList& maxSeenOccupieds,
+    BigInt maxGenerations,
+    BigIntListList& settledCounts,
+    BigInt numThreads = 0)
+{
+    const BigInt numDistances = (BigInt)seeingDistances.size();
+    const BigInt numThresholds = (BigInt)maxSeenOccupieds.size();
+    settledCounts.assign(numDistances, BigIntList(numThresholds, -1));
+    if ((numDistances == 0) || (numThresholds == 0))
+        return;
+
+    if (numThreads <= 0)
+        numThreads = std::max<BigInt>(1, std::thread::hardware_concurrency());
+
+    std::vector<std::unique_ptr<SeatingNeighborTable>> tables(numDistances);
+    auto runTasks = [numThreads](BigInt numTasks, auto runTask) {
+        std::atomic<BigInt> nextTask(0);
+        auto runNextTasks = [&]() {
+            for (BigInt task = nextTask++; task < numTasks; task = nextTask++)
+                runTask(task);
+        };
+        std::vector<std::thread> threads;
+        for (BigInt threadIndex = 1; threadIndex < std::min(numThreads, numTasks); ++threadIndex)
+            threads.emplace_back(runNextTasks);
+        runNextTasks();
+        for (std::thread& thread: threads)
+            thread.join();
+    };
+
+    runTasks(numDistances, [&](BigInt distanceIndex) {
+        tables[distanceIndex].reset(new SeatingNeighborTable(layout, seeingDistances[distanceIndex]));
+    });
+    runTasks(numDistances * numThresholds, [&](BigInt task) {
+        const BigInt distanceIndex = task / numThresholds;
+        const BigInt thresholdIndex = task % numThresholds;
+        SeatingSimulator simulator(*tables[distanceIndex]);
+        if (simulator.StepForwardUntilNothingChangesIncremental(maxSeenOccupieds[thresholdIndex], nullptr, nullptr, maxGenerations))
+            settledCounts[distanceIndex][thresholdIndex] = simulator.CountOccupiedSeats();
+    });
+}
+
 void RunSeatingSystem()
 {
     SeatingLayout testLayout("Day11TestInput.txt", true);
@@ -2319,10 +5634,60 @@ void RunSeatingSystem()
         "For main input, seeing distance of 1 and seeing max occupants 4, after settling, number of occupied seats = %lld\n",
         mainLayout.CountLocationStatesOfType('#'));
     mainLayout.Reset();
+
+    SeatingBitEngine bitEngine(mainLayout);
+    bitEngine.StepForwardUntilNothingChanges(4);
+    printf("Bitplane engine, seeing max occupants 4, number of occupied seats = %lld\n", bitEngine.CountOccupiedSeats());
+    bitEngine.Reset();
+    printf(
+        "Bitplane engine on 4 threads, number of occupied seats = %lld\n",
+        bitEngine.StepForwardUntilNothingChangesInParallel(4, 4));
+
     mainLayout.StepForwardUntilNothingChanges(-1, 5, false);
     printf(
         "For main input, seeing distance of infinity and seeing max occupants 5, after settling, number of occupied seats = %lld\n",
         mainLayout.CountLocationStatesOfType('#'));
+    mainLayout.Reset();
+
+    SeatingNeighborTable lineOfSightTable(mainLayout, -1);
+    SeatingSimulator lineOfSightSimulator(lineOfSightTable);
+    lineOfSightSimulator.StepForwardUntilNothingChanges(5);
+    printf(
+        "Line of sight neighbor table, seeing max occupants 5, number of occupied seats = %lld\n",
+        lineOfSightSimulator.CountOccupiedSeats());
+
+    lineOfSightSimulator.Reset();
+    BigInt numGenerations = 0;
+    BigInt numEvaluations = 0;
+    lineOfSightSimulator.StepForwardUntilNothingChangesIncremental(5, &numGenerations, &numEvaluations);
+    printf(
+        "Incremental stepping, number of occupied seats = %lld after %lld generations, evaluating %lld seats instead of %lld\n",
+        lineOfSightSimulator.CountOccupiedSeats(),
+        numGenerations,
+        numEvaluations,
+        (numGenerations + 1) * lineOfSightTable.GetNumSeats());
+
+    lineOfSightSimulator.Reset();
+    printf(
+        "Line of sight neighbor table on 4 threads, number of occupied seats = %lld\n",
+        lineOfSightSimulator.StepForwardUntilNothingChangesInParallel(5, 4));
+
+    const BigIntList sweepDistances = { 1, 2, 3, -1 };
+    const BigIntList sweepMaxSeenOccupieds = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    BigIntListList settledCounts;
+    SweepSeatingRules(mainLayout, sweepDistances, sweepMaxSeenOccupieds, 200, settledCounts);
+    printf("Occupied seats after settling for seeing distance (rows) and max seen occupants (columns), -1 if never settled:\n");
+    printf("          ");
+    for (const BigInt maxSeenOccupied: sweepMaxSeenOccupieds)
+        printf("%6lld", maxSeenOccupied);
+    printf("\n");
+    for (BigInt i = 0; i < (BigInt)sweepDistances.size(); ++i)
+    {
+        printf("  %6lld  ", sweepDistances[i]);
+        for (const BigInt settledCount: settledCounts[i])
+            printf("%6lld", settledCount);
+        printf("\n");
+    }
 }
 
 
@@ -2542,6 +5907,304 @@ BigInt CalcManhattanDistanceWithWaypoint(const StringList& lines, bool verbose)
     return (abs(xPos) + abs(yPos));
 }
 
+// Both kinds of navigation move a state made of the ship's position p and a direction d (the unit heading, or the
+// waypoint), and every command is an affine map of that state:
+//
+//   p' = p + forward * d + pOffset
+//   d' = rotation * d + dOffset
+//
+// where rotation is a number of quarter turns and forward is n times the identity for "Fn".  Composing two such maps
+// gives another one, and composition is associative, so a whole route (or any prefix of it) reduces to a single map,
+// and the prefixes can be computed with a parallel scan.  Composed forwards are sums of scaled rotations, so they're
+// always of the form [[a, -b], [b, a]], and only a and b are stored.
+struct RainRiskTransform
+{
+    BigInt forward[2];   // a and b
+    BigInt pOffset[2];
+    BigInt dOffset[2];
+    BigInt numQuarterTurns;   // to the right, 0 to 3
+};
+
+// one command, as read:  a move, a rotation or a forward
+struct RainRiskCommand
+{
+    int32_t arg;   // distance, or quarter turns to the right for a rotation
+    char action;   // 'N', 'S', 'E', 'W', 'R' or 'F';  left turns are stored as right turns
+    uint8_t padding[3];
+};
+
+RainRiskCommand ParseRainRiskCommand(const char* command)
+{
+    assert(strlen(command) >= 2);
+    const BigInt commandArg = atoll(command + 1);
+    assert((commandArg >= 0) && (commandArg <= INT32_MAX));
+
+    RainRiskCommand compact = {};
+    compact.action = command[0];
+    compact.arg = (int32_t)commandArg;
+    if ((command[0] == 'L') || (command[0] == 'R'))
+    {
+        assert((commandArg % 90) == 0);
+        const BigInt numQuarterTurns = (commandArg / 90) % 4;
+        compact.action = 'R';
+        compact.arg = (int32_t)((command[0] == 'L') ? ((4 - numQuarterTurns) % 4) : numQuarterTurns);
+    }
+    return compact;
+}
+
+// Positions are exact, and every function that produces one returns false if it (or any transform it's composed from)
+// doesn't fit in a BigInt;  with the waypoint, positions can grow with the square of the number of steps.
+class RainRiskNavigation
+{
+public:
+    // With useWaypoint, N/S/E/W move the waypoint and d starts at the waypoint, otherwise they move the ship and d is
+    // the unit heading, starting East;  y increases to the South.  The route is split into a chunk per thread, and
+    // each chunk is composed on its own thread, then the chunk totals are scanned in order to get the transform
+    // leading into each chunk;  only those are kept.
+    RainRiskNavigation(std::vector<RainRiskCommand>&& commands, bool useWaypoint, BigInt numThreads = 0)
+        : m_commands(std::move(commands)), m_useWaypoint(useWaypoint)
+    {
+        const BigInt numChunks = std::max<BigInt>(1, std::min(CalcNumThreads(numThreads), GetNumSteps()));
+        m_chunkBegins.resize(numChunks + 1);
+        for (BigInt chunk = 0; chunk <= numChunks; ++chunk)
+            m_chunkBegins[chunk] = GetNumSteps() * chunk / numChunks;
+
+        ComposeChunkPrefixes();
+    }
+
+    // Reads the commands straight from a file, without holding its lines:  each thread counts the lines in its part of
+    // the file, then parses them into its own range of the commands, which are then its chunk.
+    RainRiskNavigation(const char* fileName, bool useWaypoint, BigInt numThreads = 0) : m_useWaypoint(useWaypoint)
+    {
+        const BigInt fileSize = GetFileSize(fileName);
+        const BigInt numChunks = std::max<BigInt>(1, std::min(CalcNumThreads(numThreads), fileSize));
+        auto calcByteOffset = [&](BigInt chunk) { return fileSize * chunk / numChunks; };
+
+        BigIntList numChunkLines(numChunks, 0);
+        RunOnThreads(numChunks, [&](BigInt chunk) {
+            ForEachFileLineInRange(fileName, calcByteOffset(chunk), calcByteOffset(chunk + 1), [&](const char*) {
+                ++numChunkLines[chunk];
+            });
+        });
+
+        m_chunkBegins.assign(numChunks + 1, 0);
+        for (BigInt chunk = 0; chunk < numChunks; ++chunk)
+            m_chunkBegins[chunk + 1] = m_chunkBegins[chunk] + numChunkLines[chunk];
+        m_commands.resize(m_chunkBegins.back());
+
+        RunOnThreads(numChunks, [&](BigInt chunk) {
+            BigInt step = m_chunkBegins[chunk];
+            ForEachFileLineInRange(fileName, calcByteOffset(chunk), calcByteOffset(chunk + 1), [&](const char* line) {
+                m_commands[step++] = ParseRainRiskCommand(line);
+            });
+            assert(step == m_chunkBegins[chunk + 1]);
+        });
+
+        ComposeChunkPrefixes();
+    }
+
+    BigInt GetNumSteps() const { return (BigInt)m_commands.size(); }
+
+    bool CalcFinalPosition(BigInt& xPos, BigInt& yPos) const
+    {
+        return m_chunkPrefixFits.back() && ApplyToStart(m_chunkPrefixes.back(), xPos, yPos);
+    }
+
+    // position after the given step (counting from 0), from the prefix leading into its chunk and the steps before it
+    // in the chunk
+    bool CalcPositionAfterStep(BigInt step, BigInt& xPos, BigInt& yPos) const
+    {
+        assert((step >= 0) && (step < GetNumSteps()));
+        const BigInt chunk = std::upper_bound(m_chunkBegins.cbegin(), m_chunkBegins.cend(), step) - m_chunkBegins.cbegin() - 1;
+        RainRiskTransform prefixTransform;
+        return m_chunkPrefixFits[chunk]
+               && ComposeSteps(m_chunkPrefixes[chunk], m_chunkBegins[chunk], step + 1, prefixTransform)
+               && ApplyToStart(prefixTransform, xPos, yPos);
+    }
+
+    // Position after each step, with each thread scanning its chunk starting from the prefix leading into it.  If this
+    // returns false, the positions from the first one that doesn't fit on aren't meaningful.
+    bool CalcPositionsAfterEachStep(BigIntList& xPositions, BigIntList& yPositions) const
+    {
+        xPositions.resize(m_commands.size());
+        yPositions.resize(m_commands.size());
+
+        std::atomic<bool> allFit(true);
+        RunOnThreads(GetNumChunks(), [&](BigInt chunk) {
+            if (!m_chunkPrefixFits[chunk])
+            {
+                allFit = false;
+                return;
+            }
+            RainRiskTransform prefixTransform = m_chunkPrefixes[chunk];
+            for (BigInt i = m_chunkBegins[chunk]; i < m_chunkBegins[chunk + 1]; ++i)
+            {
+                if (!Compose(prefixTransform, CompileCommand(m_commands[i]), prefixTransform)
+                    || !ApplyToStart(prefixTransform, xPositions[i], yPositions[i]))
+                {
+                    allFit = false;
+                    return;
+                }
+            }
+        });
+        return allFit;
+    }
+
+private:
+    static RainRiskTransform MakeIdentity() { return RainRiskTransform{}; }
+
+    static BigInt CalcNumThreads(BigInt numThreads)
+    {
+        return (numThreads > 0) ? numThreads : std::max<BigInt>(1, std::thread::hardware_concurrency());
+    }
+
+    BigInt GetNumChunks() const { return (BigInt)m_chunkBegins.size() - 1; }
+
+    RainRiskTransform CompileCommand(const RainRiskCommand& command) const
+    {
+        RainRiskTransform transform = MakeIdentity();
+        BigInt* pMoveOffset = m_useWaypoint ? transform.dOffset : transform.pOffset;
+        switch (command.action)
+        {
+            case 'N':
+                pMoveOffset[1] = -command.arg;
+                break;
+            case 'S':
+                pMoveOffset[1] = command.arg;
+                break;
+            case 'E':
+                pMoveOffset[0] = command.arg;
+                break;
+            case 'W':
+                pMoveOffset[0] = -command.arg;
+                break;
+            case 'R':
+                transform.numQuarterTurns = command.arg;
+                break;
+            case 'F':
+                transform.forward[0] = command.arg;
+                break;
+            default:
+                assert(false && "Invalid command action");
+                break;
+        }
+        return transform;
+    }
+
+    // result = (lhs0 * rhs0) + (lhs1 * rhs1)
+    static bool CheckedDotProduct(BigInt lhs0, BigInt rhs0, BigInt lhs1, BigInt rhs1, BigInt& result)
+    {
+        BigInt product0 = 0;
+        BigInt product1 = 0;
+        return CheckedMultiply(lhs0, rhs0, product0) && CheckedMultiply(lhs1, rhs1, product1)
+               && CheckedAdd(product0, product1, result);
+    }
+
+    // a right turn takes (x, y) to (-y, x)
+    static bool RotateRight(BigInt numQuarterTurns, const BigInt vec[2], BigInt rotated[2])
+    {
+        static const BigInt s_cos[4] = { 1, 0, -1, 0 };
+        static const BigInt s_sin[4] = { 0, 1, 0, -1 };
+        return CheckedDotProduct(s_cos[numQuarterTurns], vec[0], -s_sin[numQuarterTurns], vec[1], rotated[0])
+               && CheckedDotProduct(s_sin[numQuarterTurns], vec[0], s_cos[numQuarterTurns], vec[1], rotated[1]);
+    }
+
+    // [[a, -b], [b, a]] * vec
+    static bool MultiplyForward(const BigInt forward[2], const BigInt vec[2], BigInt product[2])
+    {
+        BigInt negatedB = 0;
+        return CheckedMultiply(forward[1], -1, negatedB) && CheckedDotProduct(forward[0], vec[0], negatedB, vec[1], product[0])
+               && CheckedDotProduct(forward[1], vec[0], forward[0], vec[1], product[1]);
+    }
+
+    // first, then second:
+    //   rotation = second.rotation * first.rotation
+    //   forward = first.forward + second.forward * first.rotation
+    //   dOffset = second.rotation * first.dOffset + second.dOffset
+    //   pOffset = first.pOffset + second.forward * first.dOffset + second.pOffset
+    // composed may be first or second
+    static bool Compose(const RainRiskTransform& first, const RainRiskTransform& second, RainRiskTransform& composed)
+    {
+        BigInt rotatedForward[2];
+        BigInt rotatedDOffset[2];
+        BigInt forwardDOffset[2];
+        if (!RotateRight(first.numQuarterTurns, second.forward, rotatedForward)
+            || !RotateRight(second.numQuarterTurns, first.dOffset, rotatedDOffset)
+            || !MultiplyForward(second.forward, first.dOffset, forwardDOffset))
+            return false;
+
+        RainRiskTransform result;
+        result.numQuarterTurns = (first.numQuarterTurns + second.numQuarterTurns) % 4;
+        for (BigInt i = 0; i < 2; ++i)
+        {
+            if (!CheckedAdd(first.forward[i], rotatedForward[i], result.forward[i])
+                || !CheckedAdd(rotatedDOffset[i], second.dOffset[i], result.dOffset[i])
+                || !CheckedAdd(first.pOffset[i], forwardDOffset[i], result.pOffset[i])
+                || !CheckedAdd(result.pOffset[i], second.pOffset[i], result.pOffset[i]))
+                return false;
+        }
+        composed = result;
+        return true;
+    }
+
+    // prefix followed by steps [begin, end)
+    bool ComposeSteps(const RainRiskTransform& prefix, BigInt begin, BigInt end, RainRiskTransform& composed) const
+    {
+        composed = prefix;
+        for (BigInt i = begin; i < end; ++i)
+        {
+            if (!Compose(composed, CompileCommand(m_commands[i]), composed))
+                return false;
+        }
+        return true;
+    }
+
+    // the ship starts at the origin
+    bool ApplyToStart(const RainRiskTransform& transform, BigInt& xPos, BigInt& yPos) const
+    {
+        const BigInt initialDirection[2] = { m_useWaypoint ? 10 : 1, m_useWaypoint ? -1 : 0 };
+        BigInt forwardDirection[2];
+        return MultiplyForward(transform.forward, initialDirection, forwardDirection)
+               && CheckedAdd(forwardDirection[0], transform.pOffset[0], xPos)
+               && CheckedAdd(forwardDirection[1], transform.pOffset[1], yPos);
+    }
+
+    // runs runChunk(chunk) for each of numChunks chunks, on a thread each
+    template<typename RunChunkFunc>
+    static void RunOnThreads(BigInt numChunks, RunChunkFunc runChunk)
+    {
+        std::vector<std::thread> threads;
+        for (BigInt chunk = 1; chunk < numChunks; ++chunk)
+            threads.emplace_back(runChunk, chunk);
+        runChunk(0);
+        for (std::thread& thread: threads)
+            thread.join();
+    }
+
+    void ComposeChunkPrefixes()
+    {
+        const BigInt numChunks = GetNumChunks();
+        std::vector<RainRiskTransform> chunkTransforms(numChunks, MakeIdentity());
+        BigIntList chunkFits(numChunks, 0);   // not a BoolList, threads write neighboring entries
+        RunOnThreads(numChunks, [&](BigInt chunk) {
+            chunkFits[chunk] =
+                ComposeSteps(MakeIdentity(), m_chunkBegins[chunk], m_chunkBegins[chunk + 1], chunkTransforms[chunk]);
+        });
+
+        m_chunkPrefixes.assign(numChunks + 1, MakeIdentity());
+        m_chunkPrefixFits.assign(numChunks + 1, true);
+        for (BigInt chunk = 0; chunk < numChunks; ++chunk)
+            m_chunkPrefixFits[chunk + 1] = m_chunkPrefixFits[chunk] && chunkFits[chunk]
+                                           && Compose(m_chunkPrefixes[chunk], chunkTransforms[chunk], m_chunkPrefixes[chunk + 1]);
+    }
+
+    std::vector<RainRiskCommand> m_commands;
+    bool m_useWaypoint;
+    BigIntList m_chunkBegins;                         // numChunks + 1 step indices
+    std::vector<RainRiskTransform> m_chunkPrefixes;   // the steps before each chunk, then the whole route
+    BoolList m_chunkPrefixFits;                       // whether each of m_chunkPrefixes fits
+};
+
 void RunRainRisk()
 {
     StringList testData;
@@ -2557,6 +6220,80 @@ void RunRainRisk()
     printf(
         "Manhattan distance after running commands with waypoint in main data = %lld\n",
         CalcManhattanDistanceWithWaypoint(mainData, false));
+
+    for (const bool useWaypoint: { false, true })
+    {
+        const RainRiskNavigation navigation("Day12Input.txt", useWaypoint, 4);
+        BigInt xPos = 0;
+        BigInt yPos = 0;
+        BigIntList xPositions;
+        BigIntList yPositions;
+        if (!navigation.CalcFinalPosition(xPos, yPos) || !navigation.CalcPositionsAfterEachStep(xPositions, yPositions))
+        {
+            printf("Composed transforms%s, positions don't fit in 64 bits\n", useWaypoint ? " with waypoint" : "");
+            continue;
+        }
+        const BigInt midStep = navigation.GetNumSteps() / 2;
+        printf(
+            "Composed transforms%s, final position x = %lld, y = %lld, Manhattan distance = %lld;  after step %lld, x = %lld, y = %lld;  scan ends at x = %lld, y = %lld\n",
+            useWaypoint ? " with waypoint" : "",
+            xPos,
+            yPos,
+            abs(xPos) + abs(yPos),
+            midStep,
+            xPositions[midStep],
+            yPositions[midStep],
+            xPositions.back(),
+            yPositions.back());
+
+        // check single steps, from the chunk prefixes, against stepping the ship
+        const BigInt checkSteps[] = { 0, 1, navigation.GetNumSteps() / 3, midStep + 1, navigation.GetNumSteps() - 1 };
+        BigInt shipXPos = 0;
+        BigInt shipYPos = 0;
+        BigInt facing = 90;
+        BigInt waypointXPos = 10;
+        BigInt waypointYPos = -1;
+        BigInt numStepsTaken = 0;
+        printf("Positions after steps%s:", useWaypoint ? " with waypoint" : "");
+        for (const BigInt step: checkSteps)
+        {
+            for (; numStepsTaken <= step; ++numStepsTaken)
+            {
+                if (useWaypoint)
+                    StepRainRiskShipWithWaypoint(
+                        shipXPos, shipYPos, waypointXPos, waypointYPos, mainData[numStepsTaken], false);
+                else
+                    StepRainRiskShip(shipXPos, shipYPos, facing, mainData[numStepsTaken], false);
+            }
+            const bool fits = navigation.CalcPositionAfterStep(step, xPos, yPos);
+            assert(fits && (xPos == shipXPos) && (yPos == shipYPos));
+            assert((xPos == xPositions[step]) && (yPos == yPositions[step]));
+            printf(
+                "  %lld:  (%lld, %lld) %s",
+                step,
+                xPos,
+                yPos,
+                (fits && (xPos == shipXPos) && (yPos == shipYPos)) ? "matches" : "DOESN'T MATCH");
+        }
+        printf("\n");
+    }
+
+    // an already compacted command stream, with the waypoint pushed far enough out that the ship leaves 64 bits
+    std::vector<RainRiskCommand> farCommands;
+    for (BigInt i = 0; i < 4; ++i)
+    {
+        farCommands.push_back(ParseRainRiskCommand("E2000000000"));
+        farCommands.push_back(ParseRainRiskCommand("F2000000000"));
+    }
+    const RainRiskNavigation farNavigation(std::move(farCommands), true, 2);
+    BigInt xPos = 0;
+    BigInt yPos = 0;
+    if (farNavigation.CalcPositionAfterStep(1, xPos, yPos))
+        printf("Far waypoint, position after step 1 is x = %lld, y = %lld", xPos, yPos);
+    if (!farNavigation.CalcFinalPosition(xPos, yPos))
+        printf(";  final position doesn't fit in 64 bits\n");
+    else
+        printf(";  final position is x = %lld, y = %lld\n", xPos, yPos);
 }
 
 
@@ -4811,7 +8548,7 @@ private:
     }
 
     static const BigInt LONELY_EDGE = -1;
-    static const BigInt UNKNOWN_EDGE = -2;
+    static constexpr BigInt UNKNOWN_EDGE = -2;
 
     bool FindTileWithEdges(
         const BoolList& tilesUsed,